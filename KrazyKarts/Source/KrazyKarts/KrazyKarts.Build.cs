@@ -8,8 +8,17 @@ public class KrazyKarts : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "PhysXVehicles", "HeadMountedDisplay" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "PhysXVehicles" });
 
-		Definitions.Add("HMD_MODULE_INCLUDED=1");
+		// Dedicated servers have no headset, so keep the module out of the server binary
+		if (Target.Type != TargetType.Server)
+		{
+			PublicDependencyModuleNames.Add("HeadMountedDisplay");
+			Definitions.Add("HMD_MODULE_INCLUDED=1");
+		}
+		else
+		{
+			Definitions.Add("HMD_MODULE_INCLUDED=0");
+		}
 	}
 }
@@ -2,6 +2,44 @@
 
 #include "KrazyKarts.h"
 #include "Modules/ModuleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, KrazyKarts, "KrazyKarts" );
- 
\ No newline at end of file
+// Logs how long the process took to get ready and how much memory it holds at that point, so the
+// dedicated server target can be compared against the game target with the same map and command line.
+class FKrazyKartsModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		LogFootprint(TEXT("module startup"));
+		InitCompleteHandle = FCoreDelegates::OnFEngineLoopInitComplete.AddRaw(this, &FKrazyKartsModule::OnEngineInitComplete);
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FCoreDelegates::OnFEngineLoopInitComplete.Remove(InitCompleteHandle);
+	}
+
+private:
+	FDelegateHandle InitCompleteHandle;
+
+	void OnEngineInitComplete()
+	{
+		LogFootprint(TEXT("engine init complete"));
+	}
+
+	static void LogFootprint(const TCHAR* Stage)
+	{
+		const FPlatformMemoryStats Stats = FPlatformMemory::GetStats();
+		UE_LOG(LogTemp, Log, TEXT("KrazyKarts %s (%s): %.2fs since launch, %.1f MB resident, %.1f MB peak"),
+			Stage,
+			IsRunningDedicatedServer() ? TEXT("server") : TEXT("game"),
+			FPlatformTime::Seconds() - GStartTime,
+			Stats.UsedPhysical / (1024.0 * 1024.0),
+			Stats.PeakUsedPhysical / (1024.0 * 1024.0));
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FKrazyKartsModule, KrazyKarts, "KrazyKarts" );
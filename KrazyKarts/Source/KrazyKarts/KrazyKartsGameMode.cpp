@@ -7,5 +7,7 @@
 AKrazyKartsGameMode::AKrazyKartsGameMode()
 {
 	DefaultPawnClass = AKrazyKartsPawn::StaticClass();
+#if !UE_SERVER
 	HUDClass = AKrazyKartsHud::StaticClass();
+#endif // !UE_SERVER
 }
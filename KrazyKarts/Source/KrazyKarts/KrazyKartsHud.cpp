@@ -20,19 +20,24 @@
 #define LOCTEXT_NAMESPACE "VehicleHUD"
 
 AKrazyKartsHud::AKrazyKartsHud()
+	: SpeedTextItem(FVector2D::ZeroVector, FText::GetEmpty(), nullptr, FLinearColor::White)
+	, GearTextItem(FVector2D::ZeroVector, FText::GetEmpty(), nullptr, FLinearColor::White)
+	, LayoutCanvasSize(0, 0)
+	, DisplayedRevision(0)
 {
+	// Dedicated servers never draw a HUD, so don't load the font there
+#if !UE_SERVER
 	static ConstructorHelpers::FObjectFinder<UFont> Font(TEXT("/Engine/EngineFonts/RobotoDistanceField"));
 	HUDFont = Font.Object;
+	SpeedTextItem.Font = HUDFont;
+	GearTextItem.Font = HUDFont;
+#endif // !UE_SERVER
 }
 
 void AKrazyKartsHud::DrawHUD()
 {
 	Super::DrawHUD();
 
-	// Calculate ratio from 720p
-	const float HUDXRatio = Canvas->SizeX / 1280.f;
-	const float HUDYRatio = Canvas->SizeY / 720.f;
-
 	bool bWantHUD = true;
 #if HMD_MODULE_INCLUDED
 	if (GEngine->HMDDevice.IsValid() == true)
@@ -47,16 +52,31 @@ void AKrazyKartsHud::DrawHUD()
 		AKrazyKartsPawn* Vehicle = Cast<AKrazyKartsPawn>(GetOwningPawn());
 		if ((Vehicle != nullptr) && (Vehicle->bInCarCameraActive == false))
 		{
-			FVector2D ScaleVec(HUDYRatio * 1.4f, HUDYRatio * 1.4f);
+			const FIntPoint CanvasSize(Canvas->SizeX, Canvas->SizeY);
+			if (CanvasSize != LayoutCanvasSize)
+			{
+				// Calculate ratio from 720p
+				const float HUDXRatio = Canvas->SizeX / 1280.f;
+				const float HUDYRatio = Canvas->SizeY / 720.f;
+				FVector2D ScaleVec(HUDYRatio * 1.4f, HUDYRatio * 1.4f);
 
-			// Speed
-			FCanvasTextItem SpeedTextItem(FVector2D(HUDXRatio * 805.f, HUDYRatio * 455), Vehicle->SpeedDisplayString, HUDFont, FLinearColor::White);
-			SpeedTextItem.Scale = ScaleVec;
-			Canvas->DrawItem(SpeedTextItem);
+				SpeedTextItem.Position = FVector2D(HUDXRatio * 805.f, HUDYRatio * 455.f);
+				SpeedTextItem.Scale = ScaleVec;
+				GearTextItem.Position = FVector2D(HUDXRatio * 805.f, HUDYRatio * 500.f);
+				GearTextItem.Scale = ScaleVec;
+				LayoutCanvasSize = CanvasSize;
+			}
 
-			// Gear
-			FCanvasTextItem GearTextItem(FVector2D(HUDXRatio * 805.f, HUDYRatio * 500.f), Vehicle->GearDisplayString, HUDFont, Vehicle->bInReverseGear == false ? Vehicle->GearDisplayColor : Vehicle->GearDisplayReverseColor);
-			GearTextItem.Scale = ScaleVec;
+			if ((DisplayedVehicle != Vehicle) || (DisplayedRevision != Vehicle->GetHUDStringsRevision()))
+			{
+				SpeedTextItem.Text = Vehicle->SpeedDisplayString;
+				GearTextItem.Text = Vehicle->GearDisplayString;
+				GearTextItem.SetColor(Vehicle->bInReverseGear == false ? Vehicle->GearDisplayColor : Vehicle->GearDisplayReverseColor);
+				DisplayedVehicle = Vehicle;
+				DisplayedRevision = Vehicle->GetHUDStringsRevision();
+			}
+
+			Canvas->DrawItem(SpeedTextItem);
 			Canvas->DrawItem(GearTextItem);
 		}
 	}
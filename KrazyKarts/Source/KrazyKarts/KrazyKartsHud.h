@@ -1,6 +1,7 @@
 // Copyright 1998-2017 Epic Games, Inc. All Rights Reserved.
 #pragma once
 #include "GameFramework/HUD.h"
+#include "CanvasItem.h"
 #include "KrazyKartsHud.generated.h"
 
 
@@ -19,4 +20,16 @@ public:
 	// Begin AHUD interface
 	virtual void DrawHUD() override;
 	// End AHUD interface
+
+private:
+	/** Speed and gear items, only rebuilt when the canvas size or the pawn's strings change */
+	FCanvasTextItem SpeedTextItem;
+	FCanvasTextItem GearTextItem;
+
+	/** Canvas size the item positions were laid out for */
+	FIntPoint LayoutCanvasSize;
+
+	/** Pawn and string revision the item texts were taken from */
+	TWeakObjectPtr<class AKrazyKartsPawn> DisplayedVehicle;
+	uint32 DisplayedRevision;
 };
@@ -27,6 +27,55 @@ const FName AKrazyKartsPawn::LookRightBinding("LookRight");
 
 #define LOCTEXT_NAMESPACE "VehiclePawn"
 
+namespace
+{
+	// Speeds and gears past these are formatted on demand
+	const int32 MaxCachedKPH = 400;
+	const int32 MaxCachedGear = 16;
+
+	// Display texts are shared by every pawn and built on first use. Formatted texts rebuild themselves if the culture changes.
+	const FText& GetSpeedText(int32 KPH, FText& Scratch)
+	{
+		static TArray<FText> SpeedTexts;
+		if (KPH > MaxCachedKPH)
+		{
+			Scratch = FText::Format(LOCTEXT("SpeedFormat", "{0} km/h"), FText::AsNumber(KPH));
+			return Scratch;
+		}
+		if (SpeedTexts.Num() == 0)
+		{
+			SpeedTexts.Reserve(MaxCachedKPH + 1);
+			for (int32 i = 0; i <= MaxCachedKPH; ++i)
+			{
+				SpeedTexts.Add(FText::Format(LOCTEXT("SpeedFormat", "{0} km/h"), FText::AsNumber(i)));
+			}
+		}
+		return SpeedTexts[KPH];
+	}
+
+	// Gear is negative in reverse
+	const FText& GetGearText(int32 Gear, FText& Scratch)
+	{
+		static TArray<FText> GearTexts;
+		if (Gear > MaxCachedGear)
+		{
+			Scratch = FText::AsNumber(Gear);
+			return Scratch;
+		}
+		if (GearTexts.Num() == 0)
+		{
+			GearTexts.Reserve(MaxCachedGear + 2);
+			GearTexts.Add(LOCTEXT("ReverseGear", "R"));
+			GearTexts.Add(LOCTEXT("N", "N"));
+			for (int32 i = 1; i <= MaxCachedGear; ++i)
+			{
+				GearTexts.Add(FText::AsNumber(i));
+			}
+		}
+		return GearTexts[FMath::Max(Gear, -1) + 1];
+	}
+}
+
 AKrazyKartsPawn::AKrazyKartsPawn()
 {
 	// Car mesh
@@ -57,6 +106,8 @@ AKrazyKartsPawn::AKrazyKartsPawn()
 	Vehicle4W->WheelSetups[3].BoneName = FName("Wheel_Rear_Right");
 	Vehicle4W->WheelSetups[3].AdditionalOffset = FVector(0.f, 12.f, 0.f);
 
+	// Nobody views a dedicated server, so it gets no cameras or in-car text. Those subobjects stay null there.
+#if !UE_SERVER
 	// Create a spring arm component
 	SpringArm = CreateDefaultSubobject<USpringArmComponent>(TEXT("SpringArm0"));
 	SpringArm->TargetOffset = FVector(0.f, 0.f, 200.f);
@@ -106,6 +157,7 @@ AKrazyKartsPawn::AKrazyKartsPawn()
 	InCarGear->SetRelativeRotation(FRotator(25.0f, 180.0f,0.0f));
 	InCarGear->SetRelativeScale3D(FVector(1.0f, 0.4f, 0.4f));
 	InCarGear->SetupAttachment(GetMesh());
+#endif // !UE_SERVER
 	
 	// Colors for the incar gear display. One for normal one for reverse
 	GearDisplayReverseColor = FColor(255, 0, 0, 255);
@@ -116,6 +168,10 @@ AKrazyKartsPawn::AKrazyKartsPawn()
 	GearDisplayColor = FColor(255, 255, 255, 255);
 
 	bInReverseGear = false;
+
+	DisplayedKPH = INDEX_NONE;
+	DisplayedGear = MIN_int32;
+	HUDStringsRevision = 0;
 }
 
 void AKrazyKartsPawn::SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent)
@@ -164,6 +220,7 @@ void AKrazyKartsPawn::OnToggleCamera()
 
 void AKrazyKartsPawn::EnableIncarView(const bool bState, const bool bForce)
 {
+#if !UE_SERVER
 	if ((bState != bInCarCameraActive) || ( bForce == true ))
 	{
 		bInCarCameraActive = bState;
@@ -182,7 +239,14 @@ void AKrazyKartsPawn::EnableIncarView(const bool bState, const bool bForce)
 		
 		InCarSpeed->SetVisibility(bInCarCameraActive);
 		InCarGear->SetVisibility(bInCarCameraActive);
+
+		// The in-car text isn't updated while hidden, so catch it up
+		if (bInCarCameraActive)
+		{
+			SetupInCarHUD();
+		}
 	}
+#endif // !UE_SERVER
 }
 
 
@@ -192,12 +256,14 @@ void AKrazyKartsPawn::Tick(float Delta)
 
 	// Setup the flag to say we are in reverse gear
 	bInReverseGear = GetVehicleMovement()->GetCurrentGear() < 0;
-	
-	// Update the strings used in the hud (incar and onscreen)
-	UpdateHUDStrings();
 
-	// Set the string in the incar hud
-	SetupInCarHUD();
+#if !UE_SERVER
+	// Only the local player sees the strings. Rebuild them when the displayed speed or gear changes,
+	// and only push them to the in-car text while it's visible.
+	if (IsLocallyControlled() && UpdateHUDStrings() && bInCarCameraActive)
+	{
+		SetupInCarHUD();
+	}
 
 	bool bHMDActive = false;
 #if HMD_MODULE_INCLUDED
@@ -216,6 +282,7 @@ void AKrazyKartsPawn::Tick(float Delta)
 			InternalCamera->RelativeRotation = HeadRotation;
 		}
 	}
+#endif // !UE_SERVER
 }
 
 void AKrazyKartsPawn::BeginPlay()
@@ -241,23 +308,29 @@ void AKrazyKartsPawn::OnResetVR()
 #endif // HMD_MODULE_INCLUDED
 }
 
-void AKrazyKartsPawn::UpdateHUDStrings()
+bool AKrazyKartsPawn::UpdateHUDStrings()
 {
 	float KPH = FMath::Abs(GetVehicleMovement()->GetForwardSpeed()) * 0.036f;
 	int32 KPH_int = FMath::FloorToInt(KPH);
+	int32 Gear = bInReverseGear ? -1 : GetVehicleMovement()->GetCurrentGear();
+
+	if (KPH_int == DisplayedKPH && Gear == DisplayedGear) return false;
 
 	// Using FText because this is display text that should be localizable
-	SpeedDisplayString = FText::Format(LOCTEXT("SpeedFormat", "{0} km/h"), FText::AsNumber(KPH_int));
-	
-	if (bInReverseGear == true)
+	FText Scratch;
+	if (KPH_int != DisplayedKPH)
 	{
-		GearDisplayString = FText(LOCTEXT("ReverseGear", "R"));
+		SpeedDisplayString = GetSpeedText(KPH_int, Scratch);
+		DisplayedKPH = KPH_int;
 	}
-	else
+	if (Gear != DisplayedGear)
 	{
-		int32 Gear = GetVehicleMovement()->GetCurrentGear();
-		GearDisplayString = (Gear == 0) ? LOCTEXT("N", "N") : FText::AsNumber(Gear);
-	}	
+		GearDisplayString = GetGearText(Gear, Scratch);
+		DisplayedGear = Gear;
+	}
+
+	++HUDStringsRevision;
+	return true;
 }
 
 void AKrazyKartsPawn::SetupInCarHUD()
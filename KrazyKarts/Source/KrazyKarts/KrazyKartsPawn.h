@@ -112,8 +112,15 @@ private:
 	 */
 	void EnableIncarView( const bool bState, const bool bForce = false );
 
-	/** Update the gear and speed strings */
-	void UpdateHUDStrings();
+	/** Update the gear and speed strings. Returns false if the displayed values haven't changed. */
+	bool UpdateHUDStrings();
+
+	/** Speed (km/h) and gear the display strings were last built for */
+	int32 DisplayedKPH;
+	int32 DisplayedGear;
+
+	/** Bumped whenever the display strings change */
+	uint32 HUDStringsRevision;
 
 	/* Are we on a 'slippery' surface */
 	bool bIsLowFriction;
@@ -130,4 +137,6 @@ public:
 	FORCEINLINE UTextRenderComponent* GetInCarSpeed() const { return InCarSpeed; }
 	/** Returns InCarGear subobject **/
 	FORCEINLINE UTextRenderComponent* GetInCarGear() const { return InCarGear; }
+	/** Returns a counter that changes whenever SpeedDisplayString or GearDisplayString do **/
+	FORCEINLINE uint32 GetHUDStringsRevision() const { return HUDStringsRevision; }
 };
@@ -4,14 +4,14 @@
 
 #include "Components/InputComponent.h"
 #include "Engine/World.h"
-#include "DrawDebugHelpers.h"
+#include "GoKartManager.h"
 
 
 // Sets default values
 AGoKart::AGoKart()
 {
- 	// Set this pawn to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// Movement and replication tick from their components or the kart manager, and debug text from GoKartDebugOverlay
+	PrimaryActorTick.bCanEverTick = false;
 
 	bReplicates = true;
 	bReplicateMovement = false;
@@ -25,33 +25,30 @@ AGoKart::AGoKart()
 void AGoKart::BeginPlay()
 {
 	Super::BeginPlay();
-	
-	if (HasAuthority()) NetUpdateFrequency = 1;
+
+	Manager = AGoKartManager::Get(GetWorld());
+	if (Manager != nullptr) Manager->RegisterKart(this);
 }
 
-FString GetEnumText(ENetRole Role)
+void AGoKart::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	switch (Role)
-	{
-	case ROLE_None:
-		return "None";
-	case ROLE_SimulatedProxy:
-		return "SimulatedProxy";
-	case ROLE_AutonomousProxy:
-		return "AutonomousProxy";
-	case ROLE_Authority:
-		return "Authority";
-	default:
-		return "Error";
-	}
+	if (Manager != nullptr) Manager->UnregisterKart(this);
+
+	Super::EndPlay(EndPlayReason);
 }
 
-// Called every frame
-void AGoKart::Tick(float DeltaTime)
+void AGoKart::PossessedBy(AController* NewController)
 {
-	Super::Tick(DeltaTime);
+	Super::PossessedBy(NewController);
 
-	DrawDebugString(GetWorld(), FVector(0, 0, 100), GetEnumText(Role), this, FColor::White, DeltaTime);
+	if (Manager != nullptr) Manager->AddInputPrerequisite(NewController);
+}
+
+void AGoKart::OnRep_Controller()
+{
+	Super::OnRep_Controller();
+
+	if (Manager != nullptr) Manager->AddInputPrerequisite(Controller);
 }
 
 // Called to bind functionality to input
@@ -66,6 +63,29 @@ void AGoKart::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 	PlayerInputComponent->BindAxis("MoveRight", this, &AGoKart::MoveRight);
 }
 
+bool AGoKart::IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const
+{
+	if (Manager == nullptr || !Manager->IsRelevancyGridActive()) return Super::IsNetRelevantFor(RealViewer, ViewTarget, SrcLocation);
+
+	// Always relevant to our own player and to whoever is watching us
+	if (ViewTarget == this || IsOwnedBy(RealViewer) || IsOwnedBy(ViewTarget)) return true;
+
+	return Manager->IsKartRelevantTo(this, RealViewer);
+}
+
+float AGoKart::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, APlayerController* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	float Priority = Super::GetNetPriority(ViewPos, ViewDir, Viewer, ViewTarget, InChannel, Time, bLowBandwidth);
+
+	// Our own kart keeps the boost the engine gives owners
+	if (MovementReplicator == nullptr || ViewTarget == this) return Priority;
+
+	// Relevant karts beyond the viewer's nearest few only get what bandwidth is left over
+	if (Manager != nullptr && !Manager->IsKartFullRateFor(this, Viewer)) Priority *= 0.1f;
+
+	return Priority * MovementReplicator->GetNetPriorityScale(ViewPos);
+}
+
 void AGoKart::MoveForward(float Value)
 {
 	if (MovementComp == nullptr) return;
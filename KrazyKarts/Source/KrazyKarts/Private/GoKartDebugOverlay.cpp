@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartDebugOverlay.h"
+
+#if GOKART_DEBUG_OVERLAY
+
+#include "CanvasTypes.h"
+#include "Engine/Canvas.h"
+#include "Engine/Engine.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "GoKart.h"
+
+static TAutoConsoleVariable<int32> CVarDebugOverlay(
+	TEXT("kart.Debug.Overlay"),
+	0,
+	TEXT("Draw role, unacknowledged moves, last correction (cm) and update interval (ms) above every kart."));
+
+namespace
+{
+	const TCHAR* GetRoleText(ENetRole Role)
+	{
+		switch (Role)
+		{
+		case ROLE_None:
+			return TEXT("None");
+		case ROLE_SimulatedProxy:
+			return TEXT("SimulatedProxy");
+		case ROLE_AutonomousProxy:
+			return TEXT("AutonomousProxy");
+		case ROLE_Authority:
+			return TEXT("Authority");
+		default:
+			return TEXT("Error");
+		}
+	}
+
+	FLinearColor GetRoleColor(ENetRole Role)
+	{
+		switch (Role)
+		{
+		case ROLE_SimulatedProxy:
+			return FLinearColor::White;
+		case ROLE_AutonomousProxy:
+			return FLinearColor::Green;
+		case ROLE_Authority:
+			return FLinearColor::Yellow;
+		default:
+			return FLinearColor::Red;
+		}
+	}
+}
+
+bool FGoKartDebugOverlay::IsEnabled()
+{
+	return CVarDebugOverlay.GetValueOnGameThread() != 0;
+}
+
+void FGoKartDebugOverlay::Draw(UCanvas* Canvas, APlayerController* PlayerController, const TArray<AGoKart*>& Karts)
+{
+	if (!IsEnabled() || Canvas == nullptr || Canvas->Canvas == nullptr) return;
+
+	const UFont* Font = GEngine->GetSmallFont();
+	const float LineHeight = 12.0f;
+
+	TCHAR Line[128];
+
+	for (const AGoKart* Kart : Karts)
+	{
+		if (Kart == nullptr) continue;
+
+		FVector ScreenLocation = Canvas->Project(Kart->GetActorLocation() + FVector(0, 0, 100));
+		// Behind the camera
+		if (ScreenLocation.Z <= 0) continue;
+
+		ENetRole Role = Kart->Role;
+		FLinearColor Color = GetRoleColor(Role);
+		float X = ScreenLocation.X;
+		float Y = ScreenLocation.Y;
+
+		Canvas->Canvas->DrawShadowedString(X, Y, GetRoleText(Role), Font, Color);
+
+		const UGoKartMovementReplicator* Replicator = Kart->FindComponentByClass<UGoKartMovementReplicator>();
+		if (Replicator == nullptr) continue;
+
+		FCString::Snprintf(Line, ARRAY_COUNT(Line), TEXT("Unacked %d  Corr %.1fcm (%u)"), Replicator->GetNumUnacknowledgedMoves(), Replicator->GetLastCorrectionSize(), Replicator->GetCorrectionCount());
+		Canvas->Canvas->DrawShadowedString(X, Y + LineHeight, Line, Font, Color);
+
+		FCString::Snprintf(Line, ARRAY_COUNT(Line), TEXT("Update %.0fms"), Replicator->GetUpdateInterval() * 1000.0f);
+		Canvas->Canvas->DrawShadowedString(X, Y + 2 * LineHeight, Line, Font, Color);
+	}
+}
+
+#endif
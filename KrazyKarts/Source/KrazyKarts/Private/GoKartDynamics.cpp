@@ -0,0 +1,215 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartDynamics.h"
+
+#include "Math/VectorRegister.h"
+#include "Math/RandomStream.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	typedef FGoKartDynamicsBatch FBatch;
+
+	// Steps LaneCount karts starting at Index. Streams must hold at least Index + LaneCount floats.
+	FORCEINLINE void StepLanes(const FGoKartDynamicsParams& Params, float* const* Streams, int32 Index)
+	{
+		const VectorRegister Zero = VectorZero();
+		const VectorRegister One = VectorOne();
+		const VectorRegister SmallNumber = VectorSetFloat1(SMALL_NUMBER);
+		const VectorRegister InvMass = VectorSetFloat1(Params.InvMass);
+		const VectorRegister DrivingAcceleration = VectorSetFloat1(Params.DrivingAcceleration);
+		const VectorRegister DragCoef = VectorSetFloat1(Params.DragCoef);
+		const VectorRegister RollingForce = VectorSetFloat1(Params.RollingForce);
+		const VectorRegister InvTurningRadius = VectorSetFloat1(Params.InvTurningRadius);
+		// MPS * 100 = CMPS
+		const VectorRegister MetersToCentimeters = VectorSetFloat1(100.0f);
+
+		VectorRegister VelX = VectorLoad(Streams[FBatch::VelocityX] + Index);
+		VectorRegister VelY = VectorLoad(Streams[FBatch::VelocityY] + Index);
+		VectorRegister VelZ = VectorLoad(Streams[FBatch::VelocityZ] + Index);
+		const VectorRegister FwdX = VectorLoad(Streams[FBatch::ForwardX] + Index);
+		const VectorRegister FwdY = VectorLoad(Streams[FBatch::ForwardY] + Index);
+		const VectorRegister FwdZ = VectorLoad(Streams[FBatch::ForwardZ] + Index);
+		const VectorRegister UpX = VectorLoad(Streams[FBatch::UpX] + Index);
+		const VectorRegister UpY = VectorLoad(Streams[FBatch::UpY] + Index);
+		const VectorRegister UpZ = VectorLoad(Streams[FBatch::UpZ] + Index);
+		const VectorRegister Throttle = VectorLoad(Streams[FBatch::Throttle] + Index);
+		const VectorRegister SteeringThrow = VectorLoad(Streams[FBatch::SteeringThrow] + Index);
+		const VectorRegister DeltaTime = VectorLoad(Streams[FBatch::DeltaTime] + Index);
+
+		// Air drag (-v^ * |v|^2 * Cd) and rolling resistance (-v^ * Crr * N) both point against v,
+		// so they fold into -v * (|v| * Cd + Crr * N / |v|). Zero at rest, like FVector::GetSafeNormal.
+		VectorRegister SpeedSquared = VectorMultiplyAdd(VelZ, VelZ, VectorMultiplyAdd(VelY, VelY, VectorMultiply(VelX, VelX)));
+		VectorRegister Moving = VectorCompareGT(SpeedSquared, SmallNumber);
+
+		// Hardware reciprocal square root is an estimate that differs between CPUs, which would break client and
+		// server agreement. Scalar sqrt and divide are correctly rounded everywhere.
+		MS_ALIGN(16) float Lanes[FBatch::LaneCount] GCC_ALIGN(16);
+		VectorStoreAligned(VectorMax(SpeedSquared, SmallNumber), Lanes);
+		for (int32 Lane = 0; Lane < FBatch::LaneCount; ++Lane) Lanes[Lane] = FMath::Sqrt(Lanes[Lane]);
+		VectorRegister Speed = VectorLoadAligned(Lanes);
+		for (int32 Lane = 0; Lane < FBatch::LaneCount; ++Lane) Lanes[Lane] = 1.0f / Lanes[Lane];
+		VectorRegister InvSpeed = VectorLoadAligned(Lanes);
+
+		VectorRegister Resistance = VectorMultiplyAdd(Speed, DragCoef, VectorMultiply(InvSpeed, RollingForce));
+		Resistance = VectorSelect(Moving, VectorMultiply(Resistance, InvMass), Zero);
+
+		// a = F / m, dv = a * dt
+		VectorRegister Drive = VectorMultiply(Throttle, DrivingAcceleration);
+		VelX = VectorMultiplyAdd(VectorSubtract(VectorMultiply(FwdX, Drive), VectorMultiply(VelX, Resistance)), DeltaTime, VelX);
+		VelY = VectorMultiplyAdd(VectorSubtract(VectorMultiply(FwdY, Drive), VectorMultiply(VelY, Resistance)), DeltaTime, VelY);
+		VelZ = VectorMultiplyAdd(VectorSubtract(VectorMultiply(FwdZ, Drive), VectorMultiply(VelZ, Resistance)), DeltaTime, VelZ);
+
+		// Turning angle from the distance travelled along the forward vector
+		VectorRegister ForwardSpeed = VectorMultiplyAdd(FwdZ, VelZ, VectorMultiplyAdd(FwdY, VelY, VectorMultiply(FwdX, VelX)));
+		VectorRegister Angle = VectorMultiply(VectorMultiply(VectorMultiply(ForwardSpeed, DeltaTime), InvTurningRadius), SteeringThrow);
+
+		// Rotating our velocity as we rotate the car (Rodrigues' formula around Up)
+		VectorRegister Sin, Cos;
+		VectorSinCos(&Sin, &Cos, &Angle);
+		VectorRegister UpDotVel = VectorMultiplyAdd(UpZ, VelZ, VectorMultiplyAdd(UpY, VelY, VectorMultiply(UpX, VelX)));
+		VectorRegister Along = VectorMultiply(UpDotVel, VectorSubtract(One, Cos));
+		VectorRegister CrossX = VectorSubtract(VectorMultiply(UpY, VelZ), VectorMultiply(UpZ, VelY));
+		VectorRegister CrossY = VectorSubtract(VectorMultiply(UpZ, VelX), VectorMultiply(UpX, VelZ));
+		VectorRegister CrossZ = VectorSubtract(VectorMultiply(UpX, VelY), VectorMultiply(UpY, VelX));
+		VelX = VectorMultiplyAdd(UpX, Along, VectorMultiplyAdd(CrossX, Sin, VectorMultiply(VelX, Cos)));
+		VelY = VectorMultiplyAdd(UpY, Along, VectorMultiplyAdd(CrossY, Sin, VectorMultiply(VelY, Cos)));
+		VelZ = VectorMultiplyAdd(UpZ, Along, VectorMultiplyAdd(CrossZ, Sin, VectorMultiply(VelZ, Cos)));
+
+		VectorRegister TranslationScale = VectorMultiply(DeltaTime, MetersToCentimeters);
+
+		VectorStore(VelX, Streams[FBatch::VelocityX] + Index);
+		VectorStore(VelY, Streams[FBatch::VelocityY] + Index);
+		VectorStore(VelZ, Streams[FBatch::VelocityZ] + Index);
+		VectorStore(Angle, Streams[FBatch::RotationAngle] + Index);
+		VectorStore(VectorMultiply(VelX, TranslationScale), Streams[FBatch::TranslationX] + Index);
+		VectorStore(VectorMultiply(VelY, TranslationScale), Streams[FBatch::TranslationY] + Index);
+		VectorStore(VectorMultiply(VelZ, TranslationScale), Streams[FBatch::TranslationZ] + Index);
+	}
+}
+
+void FGoKartDynamicsBatch::Reset(int32 InNum)
+{
+	NumKarts = InNum;
+
+	int32 PaddedNum = Align(InNum, LaneCount);
+	for (TArray<float>& Stream : Streams)
+	{
+		Stream.SetNumUninitialized(PaddedNum, false);
+		FMemory::Memzero(Stream.GetData(), PaddedNum * sizeof(float));
+	}
+}
+
+void FGoKartDynamicsBatch::SetKart(int32 Index, const FGoKartDynamicsKart& Kart)
+{
+	check(Index >= 0 && Index < NumKarts);
+
+	Streams[VelocityX][Index] = Kart.Velocity.X;
+	Streams[VelocityY][Index] = Kart.Velocity.Y;
+	Streams[VelocityZ][Index] = Kart.Velocity.Z;
+	Streams[ForwardX][Index] = Kart.Forward.X;
+	Streams[ForwardY][Index] = Kart.Forward.Y;
+	Streams[ForwardZ][Index] = Kart.Forward.Z;
+	Streams[UpX][Index] = Kart.Up.X;
+	Streams[UpY][Index] = Kart.Up.Y;
+	Streams[UpZ][Index] = Kart.Up.Z;
+	Streams[Throttle][Index] = Kart.Throttle;
+	Streams[SteeringThrow][Index] = Kart.SteeringThrow;
+	Streams[DeltaTime][Index] = Kart.DeltaTime;
+}
+
+void FGoKartDynamicsBatch::GetKart(int32 Index, FGoKartDynamicsKart& OutKart) const
+{
+	check(Index >= 0 && Index < NumKarts);
+
+	OutKart.Velocity = FVector(Streams[VelocityX][Index], Streams[VelocityY][Index], Streams[VelocityZ][Index]);
+	OutKart.RotationAngle = Streams[RotationAngle][Index];
+	OutKart.Translation = FVector(Streams[TranslationX][Index], Streams[TranslationY][Index], Streams[TranslationZ][Index]);
+}
+
+void FGoKartDynamics::StepBatch(const FGoKartDynamicsParams& Params, FGoKartDynamicsBatch& Batch)
+{
+	StepRange(Params, Batch, 0, Batch.Num());
+}
+
+void FGoKartDynamics::StepRange(const FGoKartDynamicsParams& Params, FGoKartDynamicsBatch& Batch, int32 Start, int32 Count)
+{
+	check(Start % FBatch::LaneCount == 0);
+	check(Start >= 0 && Start + Count <= Batch.Num());
+
+	float* Streams[FBatch::NumStreams];
+	for (int32 Stream = 0; Stream < FBatch::NumStreams; ++Stream) Streams[Stream] = Batch.GetStream((FBatch::EStream)Stream);
+
+	// Streams are padded, so the last partial group of lanes steps idle karts
+	for (int32 Index = Start; Index < Start + Count; Index += FBatch::LaneCount) StepLanes(Params, Streams, Index);
+}
+
+void FGoKartDynamics::Step(const FGoKartDynamicsParams& Params, FGoKartDynamicsKart& Kart)
+{
+	float Lanes[FBatch::NumStreams][FBatch::LaneCount] = {};
+	float* Streams[FBatch::NumStreams];
+	for (int32 Stream = 0; Stream < FBatch::NumStreams; ++Stream) Streams[Stream] = Lanes[Stream];
+
+	Lanes[FBatch::VelocityX][0] = Kart.Velocity.X;
+	Lanes[FBatch::VelocityY][0] = Kart.Velocity.Y;
+	Lanes[FBatch::VelocityZ][0] = Kart.Velocity.Z;
+	Lanes[FBatch::ForwardX][0] = Kart.Forward.X;
+	Lanes[FBatch::ForwardY][0] = Kart.Forward.Y;
+	Lanes[FBatch::ForwardZ][0] = Kart.Forward.Z;
+	Lanes[FBatch::UpX][0] = Kart.Up.X;
+	Lanes[FBatch::UpY][0] = Kart.Up.Y;
+	Lanes[FBatch::UpZ][0] = Kart.Up.Z;
+	Lanes[FBatch::Throttle][0] = Kart.Throttle;
+	Lanes[FBatch::SteeringThrow][0] = Kart.SteeringThrow;
+	Lanes[FBatch::DeltaTime][0] = Kart.DeltaTime;
+
+	StepLanes(Params, Streams, 0);
+
+	Kart.Velocity = FVector(Lanes[FBatch::VelocityX][0], Lanes[FBatch::VelocityY][0], Lanes[FBatch::VelocityZ][0]);
+	Kart.RotationAngle = Lanes[FBatch::RotationAngle][0];
+	Kart.Translation = FVector(Lanes[FBatch::TranslationX][0], Lanes[FBatch::TranslationY][0], Lanes[FBatch::TranslationZ][0]);
+}
+
+// Times StepBatch against stepping the same karts one by one, so the kernel can be profiled on a headless server
+static void RunDynamicsBenchmark(const TArray<FString>& Args)
+{
+	int32 NumKarts = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 32;
+	int32 NumSteps = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 10000;
+
+	FGoKartDynamicsParams Params;
+	FRandomStream Random(NumKarts);
+
+	TArray<FGoKartDynamicsKart> Karts;
+	FGoKartDynamicsBatch Batch;
+	Batch.Reset(NumKarts);
+	for (int32 Index = 0; Index < NumKarts; ++Index)
+	{
+		FGoKartDynamicsKart Kart;
+		Kart.Velocity = Random.GetUnitVector() * Random.FRandRange(0.0f, 30.0f);
+		Kart.Throttle = Random.FRandRange(-1.0f, 1.0f);
+		Kart.SteeringThrow = Random.FRandRange(-1.0f, 1.0f);
+		Kart.DeltaTime = 1.0f / 60.0f;
+		Karts.Add(Kart);
+		Batch.SetKart(Index, Kart);
+	}
+
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Step = 0; Step < NumSteps; ++Step) FGoKartDynamics::StepBatch(Params, Batch);
+	double BatchTime = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Step = 0; Step < NumSteps; ++Step)
+	{
+		for (FGoKartDynamicsKart& Kart : Karts) FGoKartDynamics::Step(Params, Kart);
+	}
+	double SingleTime = FPlatformTime::Seconds() - StartTime;
+
+	double KartSteps = (double)NumKarts * NumSteps;
+	UE_LOG(LogTemp, Display, TEXT("Dynamics benchmark, %d karts x %d steps: StepBatch %.1fns per kart step, Step %.1fns per kart step (%.2fx)"),
+		NumKarts, NumSteps, BatchTime * 1e9 / KartSteps, SingleTime * 1e9 / KartSteps, SingleTime / FMath::Max(BatchTime, 1e-9));
+}
+
+static FAutoConsoleCommand DynamicsBenchmarkCommand(
+	TEXT("kart.Dynamics.Benchmark"),
+	TEXT("Times FGoKartDynamics::StepBatch against single kart Step. Args: [Karts] [Steps]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunDynamicsBenchmark));
@@ -0,0 +1,253 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartLoadTest.h"
+
+#include "Engine/World.h"
+#include "GameFramework/PlayerStart.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "GoKart.h"
+#include "GoKartMovementReplicator.h"
+
+static TAutoConsoleVariable<FString> CVarLoadTestKartClass(
+	TEXT("kart.LoadTest.KartClass"),
+	TEXT("/Game/KrazyKarts/Blueprints/BP_GoKart.BP_GoKart_C"),
+	TEXT("Class spawned for load test bots. Falls back to AGoKart when it can not be loaded."));
+
+static TAutoConsoleVariable<int32> CVarLoadTestExitWhenDone(
+	TEXT("kart.LoadTest.ExitWhenDone"),
+	0,
+	TEXT("Exit the process once a load test has written its CSV, for CI runs."));
+
+static void StartLoadTest(const TArray<FString>& Args, UWorld* World)
+{
+	if (World == nullptr || World->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogTemp, Error, TEXT("kart.LoadTest.Start must run on a server or standalone world."));
+		return;
+	}
+
+	int32 NumKarts = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 32;
+	float Duration = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 60.0f;
+	bool bRandomInput = Args.Num() < 3 || Args[2] != TEXT("scripted");
+	FString CsvPath = Args.Num() > 3 ? Args[3] : FPaths::GameSavedDir() / TEXT("LoadTest") / FString::Printf(TEXT("KartLoadTest-%s.csv"), *FDateTime::Now().ToString());
+
+	AGoKartLoadTest* LoadTest = World->SpawnActor<AGoKartLoadTest>();
+	if (LoadTest != nullptr) LoadTest->StartTest(NumKarts, Duration, bRandomInput, CsvPath);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs StartLoadTestCommand(
+	TEXT("kart.LoadTest.Start"),
+	TEXT("Spawns bot karts and records server load to CSV. Args: NumKarts Duration [random|scripted] [CsvPath]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StartLoadTest));
+
+AGoKartLoadTest::AGoKartLoadTest()
+{
+	// Bots make their moves before the kart manager simulates them
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
+
+void AGoKartLoadTest::BeginPlay()
+{
+	Super::BeginPlay();
+
+	BeginFrameHandle = FCoreDelegates::OnBeginFrame.AddUObject(this, &AGoKartLoadTest::BeginFrame);
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &AGoKartLoadTest::EndFrame);
+}
+
+void AGoKartLoadTest::StartTest(int32 NumKarts, float Duration, bool bInRandomInput, const FString& InCsvPath)
+{
+	bRandomInput = bInRandomInput;
+	TestDuration = Duration;
+	CsvPath = InCsvPath;
+
+	CsvLines.Add(TEXT("Time,Karts,FrameMsP50,FrameMsP95,FrameMsP99,FrameMsMax,MoveRpcsPerSec,MovesPerSec"));
+
+	SpawnBots(NumKarts);
+
+	UE_LOG(LogTemp, Display, TEXT("Kart load test: %d karts for %.0fs, writing %s"), Bots.Num(), Duration, *CsvPath);
+}
+
+void AGoKartLoadTest::SpawnBots(int32 NumKarts)
+{
+	UClass* KartClass = LoadClass<AGoKart>(nullptr, *CVarLoadTestKartClass.GetValueOnGameThread());
+	if (KartClass == nullptr) KartClass = AGoKart::StaticClass();
+
+	FVector Origin = FVector(0, 0, 100);
+	TActorIterator<APlayerStart> PlayerStart(GetWorld());
+	if (PlayerStart) Origin = PlayerStart->GetActorLocation();
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	// Lay the karts out on a square grid, 5m apart
+	const float Spacing = 500.0f;
+	int32 Columns = FMath::CeilToInt(FMath::Sqrt((float)NumKarts));
+
+	for (int32 Index = 0; Index < NumKarts; ++Index)
+	{
+		FVector Location = Origin + FVector((Index / Columns) * Spacing, (Index % Columns) * Spacing, 0);
+		AActor* Kart = GetWorld()->SpawnActor<AActor>(KartClass, Location, FRotator::ZeroRotator, SpawnParams);
+		if (Kart == nullptr) continue;
+
+		UGoKartMovementComp* MovementComp = Kart->FindComponentByClass<UGoKartMovementComp>();
+		UGoKartMovementReplicator* Replicator = Kart->FindComponentByClass<UGoKartMovementReplicator>();
+		if (MovementComp == nullptr || Replicator == nullptr) continue;
+
+		MovementComp->SetExternalMoveSource(true);
+
+		FBot Bot;
+		Bot.Kart = Kart;
+		Bot.Replicator = Replicator;
+		Bot.Random.Initialize(Index);
+		Bot.Throttle = 1.0f;
+		Bot.SteeringThrow = 0.0f;
+		Bot.NextInputChangeTime = 0.0f;
+		Bot.ClientTime = 0.0f;
+		Bot.StepAccumulator = 0.0f;
+		Bot.SendAccumulator = 0.0f;
+		Bot.NextSequence = 1;
+		Bots.Add(Bot);
+	}
+}
+
+void AGoKartLoadTest::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	for (FBot& Bot : Bots)
+	{
+		if (Bot.Kart.IsValid()) DriveBot(Bot, DeltaTime);
+	}
+
+	TestTime += DeltaTime;
+	TimeSinceRow += DeltaTime;
+}
+
+void AGoKartLoadTest::DriveBot(FBot& Bot, float DeltaTime)
+{
+	// Same rates as a client using a 60 Hz fixed step and 30 Hz batched upload
+	const float StepTime = 1.0f / 60.0f;
+	const float SendInterval = 1.0f / 30.0f;
+
+	if (bRandomInput)
+	{
+		if (TestTime >= Bot.NextInputChangeTime)
+		{
+			Bot.Throttle = Bot.Random.FRandRange(0.3f, 1.0f);
+			Bot.SteeringThrow = Bot.Random.FRandRange(-1.0f, 1.0f);
+			Bot.NextInputChangeTime = TestTime + Bot.Random.FRandRange(0.5f, 3.0f);
+		}
+	}
+	else
+	{
+		Bot.Throttle = 1.0f;
+		Bot.SteeringThrow = FMath::Sin(TestTime);
+	}
+
+	Bot.StepAccumulator += DeltaTime;
+	while (Bot.StepAccumulator >= StepTime)
+	{
+		Bot.StepAccumulator -= StepTime;
+		Bot.ClientTime += StepTime;
+
+		FGoKartMove Move;
+		Move.Throttle = Bot.Throttle;
+		Move.SteeringThrow = Bot.SteeringThrow;
+		Move.DeltaTime = StepTime;
+		Move.Time = Bot.ClientTime;
+		Move.Sequence = Bot.NextSequence++;
+		Bot.PendingMoves.Add(Move);
+	}
+
+	Bot.SendAccumulator += DeltaTime;
+	if (Bot.SendAccumulator >= SendInterval && Bot.PendingMoves.Num() > 0)
+	{
+		Bot.SendAccumulator = FMath::Fmod(Bot.SendAccumulator, SendInterval);
+
+		// After a hitch more moves are pending than one packet may carry
+		int32 MaxMovesPerPacket = Bot.Replicator->GetMaxMovesPerPacket();
+		while (Bot.PendingMoves.Num() > MaxMovesPerPacket)
+		{
+			TArray<FGoKartMove> Packet(Bot.PendingMoves.GetData(), MaxMovesPerPacket);
+			Bot.Replicator->ReceiveLoopbackMoves(Packet);
+			Bot.PendingMoves.RemoveAt(0, MaxMovesPerPacket, false);
+		}
+		Bot.Replicator->ReceiveLoopbackMoves(Bot.PendingMoves);
+		Bot.PendingMoves.Reset();
+	}
+}
+
+void AGoKartLoadTest::BeginFrame()
+{
+	FrameStartTime = FPlatformTime::Seconds();
+}
+
+void AGoKartLoadTest::EndFrame()
+{
+	// The first frame started before we subscribed
+	if (Bots.Num() == 0 || FrameStartTime == 0) return;
+
+	FrameTimes.Add((float)((FPlatformTime::Seconds() - FrameStartTime) * 1000.0));
+
+	if (TimeSinceRow >= 1.0f) WriteRow();
+
+	if (TestTime >= TestDuration) FinishTest();
+}
+
+void AGoKartLoadTest::WriteRow()
+{
+	FrameTimes.Sort();
+
+	auto Percentile = [this](float Fraction) { return FrameTimes[FMath::Min(FrameTimes.Num() - 1, FMath::FloorToInt(Fraction * FrameTimes.Num()))]; };
+
+	uint32 PacketsReceived = 0;
+	uint32 MovesReceived = 0;
+	for (const FBot& Bot : Bots)
+	{
+		if (!Bot.Kart.IsValid()) continue;
+
+		PacketsReceived += Bot.Replicator->GetServerPacketsReceived();
+		MovesReceived += Bot.Replicator->GetServerMovesReceived();
+	}
+
+	CsvLines.Add(FString::Printf(TEXT("%.2f,%d,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f"), TestTime, Bots.Num(),
+		Percentile(0.5f), Percentile(0.95f), Percentile(0.99f), FrameTimes.Last(),
+		(PacketsReceived - LastPacketsReceived) / TimeSinceRow, (MovesReceived - LastMovesReceived) / TimeSinceRow));
+
+	LastPacketsReceived = PacketsReceived;
+	LastMovesReceived = MovesReceived;
+	FrameTimes.Reset();
+	TimeSinceRow = 0;
+}
+
+void AGoKartLoadTest::FinishTest()
+{
+	if (FFileHelper::SaveStringArrayToFile(CsvLines, *CsvPath)) UE_LOG(LogTemp, Display, TEXT("Kart load test finished, wrote %s"), *CsvPath);
+	else UE_LOG(LogTemp, Error, TEXT("Kart load test could not write %s"), *CsvPath);
+
+	for (const FBot& Bot : Bots)
+	{
+		if (Bot.Kart.IsValid()) Bot.Kart->Destroy();
+	}
+	Bots.Reset();
+
+	if (CVarLoadTestExitWhenDone.GetValueOnGameThread() != 0) FPlatformMisc::RequestExit(false);
+
+	Destroy();
+}
+
+void AGoKartLoadTest::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	FCoreDelegates::OnBeginFrame.Remove(BeginFrameHandle);
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+
+	// Keep whatever was measured if the world goes away mid test
+	if (Bots.Num() > 0) FFileHelper::SaveStringArrayToFile(CsvLines, *CsvPath);
+}
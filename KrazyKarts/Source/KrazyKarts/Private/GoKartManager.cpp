@@ -0,0 +1,631 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartManager.h"
+
+#include "Engine/World.h"
+#include "Components/PrimitiveComponent.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "GoKart.h"
+#include "GoKartRacingLine.h"
+#include "GoKartStats.h"
+
+#if GOKART_DEBUG_OVERLAY
+#include "Debug/DebugDrawService.h"
+#endif
+
+DECLARE_CYCLE_STAT(TEXT("Manager Simulation Tick"), STAT_GoKart_ManagerSimulationTick, STATGROUP_GoKart);
+DECLARE_CYCLE_STAT(TEXT("Update Bots"), STAT_GoKart_UpdateBots, STATGROUP_GoKart);
+DECLARE_CYCLE_STAT(TEXT("Proxy Smoothing"), STAT_GoKart_ProxySmoothing, STATGROUP_GoKart);
+DECLARE_CYCLE_STAT(TEXT("Step Dynamics Batch"), STAT_GoKart_StepDynamicsBatch, STATGROUP_GoKart);
+
+static TAutoConsoleVariable<int32> CVarBatchedTick(
+	TEXT("kart.Manager.BatchedTick"),
+	1,
+	TEXT("Tick every kart's movement and replication from the kart manager in one pass, instead of one tick per component."));
+
+static TAutoConsoleVariable<int32> CVarParallelServerSimulation(
+	TEXT("kart.Parallel.ServerSimulation"),
+	1,
+	TEXT("Simulate client moves for all karts across worker threads on servers. Needs kart.Manager.BatchedTick."));
+
+static TAutoConsoleVariable<int32> CVarParallelMinKarts(
+	TEXT("kart.Parallel.MinKarts"),
+	8,
+	TEXT("Fewest karts worth simulating in parallel. Below this the task overhead costs more than it saves."));
+
+static TAutoConsoleVariable<int32> CVarRelevancyGrid(
+	TEXT("kart.Relevancy.Grid"),
+	1,
+	TEXT("Replicate karts only to viewers within kart.Relevancy.ViewRadius grid cells."));
+
+static TAutoConsoleVariable<float> CVarRelevancyCellSize(
+	TEXT("kart.Relevancy.CellSize"),
+	5000.0f,
+	TEXT("Relevancy grid cell size (cm)."));
+
+static TAutoConsoleVariable<int32> CVarRelevancyViewRadius(
+	TEXT("kart.Relevancy.ViewRadius"),
+	2,
+	TEXT("Cells around a viewer's cell whose karts it receives."));
+
+static TAutoConsoleVariable<int32> CVarRelevancyMaxFullRateKarts(
+	TEXT("kart.Relevancy.MaxFullRateKarts"),
+	16,
+	TEXT("Nearest relevant karts each viewer receives at full priority. The rest are deprioritized."));
+
+// Read only, so a running server never switches between the grid and sweeps
+static TAutoConsoleVariable<int32> CVarTrackCollisionGrid(
+	TEXT("kart.Collision.TrackGrid"),
+	0,
+	TEXT("Servers bake the track into a height grid when a world starts, and resolve kart moves against it instead of sweeping. Clients always sweep."),
+	ECVF_ReadOnly);
+
+static TAutoConsoleVariable<float> CVarTrackCollisionCellSize(
+	TEXT("kart.Collision.CellSize"),
+	25.0f,
+	TEXT("Track collision grid cell size (cm)."));
+
+static TAutoConsoleVariable<float> CVarTrackCollisionMaxStepHeight(
+	TEXT("kart.Collision.MaxStepHeight"),
+	30.0f,
+	TEXT("Surfaces higher than this above the kart's floor are walls (cm)."));
+
+static void BakeTrackCollisionForWorld(UWorld* World)
+{
+	if (World == nullptr || World->GetNetMode() == NM_Client || CVarTrackCollisionGrid.GetValueOnGameThread() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("kart.Collision.BakeTrack needs kart.Collision.TrackGrid on, and a server or standalone world."));
+		return;
+	}
+
+	AGoKartManager* Manager = AGoKartManager::Get(World);
+	if (Manager != nullptr) Manager->BakeTrackCollision();
+}
+
+static FAutoConsoleCommandWithWorld BakeTrackCollisionCommand(
+	TEXT("kart.Collision.BakeTrack"),
+	TEXT("Re-bakes the track collision grid, e.g. after changing kart.Collision.CellSize."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&BakeTrackCollisionForWorld));
+
+static TAutoConsoleVariable<FString> CVarBotKartClass(
+	TEXT("kart.Bots.KartClass"),
+	TEXT("/Game/KrazyKarts/Blueprints/BP_GoKart.BP_GoKart_C"),
+	TEXT("Class spawned for bots. Falls back to AGoKart when it can not be loaded."));
+
+static TAutoConsoleVariable<float> CVarBotLookAheadTime(
+	TEXT("kart.Bots.LookAheadTime"),
+	0.6f,
+	TEXT("How far ahead along the racing line bots aim, in seconds at their current speed."));
+
+static TAutoConsoleVariable<float> CVarBotMinLookAhead(
+	TEXT("kart.Bots.MinLookAhead"),
+	500.0f,
+	TEXT("Shortest distance ahead along the racing line bots aim (cm)."));
+
+static void SpawnBots(const TArray<FString>& Args, UWorld* World)
+{
+	if (World == nullptr || World->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogTemp, Error, TEXT("kart.Bots.Spawn must run on a server or standalone world."));
+		return;
+	}
+
+	AGoKartManager* Manager = AGoKartManager::Get(World);
+	if (Manager != nullptr) Manager->SpawnBots(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 16);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs SpawnBotsCommand(
+	TEXT("kart.Bots.Spawn"),
+	TEXT("Spawns server-driven karts that follow the level's AGoKartRacingLine. Args: [Count]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&SpawnBots));
+
+static void DestroyBots(UWorld* World)
+{
+	AGoKartManager* Manager = AGoKartManager::Get(World);
+	if (Manager != nullptr) Manager->DestroyBots();
+}
+
+static FAutoConsoleCommandWithWorld DestroyBotsCommand(
+	TEXT("kart.Bots.Destroy"),
+	TEXT("Destroys every bot kart."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&DestroyBots));
+
+void FGoKartManagerSimulationTick::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Target != nullptr && !Target->IsPendingKill()) Target->TickSimulation(DeltaTime);
+}
+
+FString FGoKartManagerSimulationTick::DiagnosticMessage()
+{
+	return TEXT("FGoKartManagerSimulationTick");
+}
+
+AGoKartManager::AGoKartManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	// After karts have moved, before the net driver replicates them
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	// Where the kart components would have ticked
+	SimulationTick.bCanEverTick = true;
+	SimulationTick.TickGroup = TG_PrePhysics;
+	SimulationTick.Target = nullptr;
+
+	bReplicates = false;
+}
+
+void AGoKartManager::RegisterActorTickFunctions(bool bRegister)
+{
+	Super::RegisterActorTickFunctions(bRegister);
+
+	if (bRegister)
+	{
+		SimulationTick.Target = this;
+		SimulationTick.RegisterTickFunction(GetLevel());
+	}
+	else if (SimulationTick.IsTickFunctionRegistered())
+	{
+		SimulationTick.UnRegisterTickFunction();
+	}
+}
+
+AGoKartManager* AGoKartManager::Get(UWorld* World)
+{
+	if (World == nullptr) return nullptr;
+
+	for (TActorIterator<AGoKartManager> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill()) return *It;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	return World->SpawnActor<AGoKartManager>(SpawnParams);
+}
+
+void AGoKartManager::RegisterKart(AGoKart* Kart)
+{
+	if (Kart == nullptr || Karts.Contains(Kart)) return;
+
+	Karts.Add(Kart);
+
+	FSimulatedKart SimulatedKart;
+	SimulatedKart.Kart = Kart;
+	SimulatedKart.MovementComp = Kart->FindComponentByClass<UGoKartMovementComp>();
+	SimulatedKart.Replicator = Kart->FindComponentByClass<UGoKartMovementReplicator>();
+	SimulatedKart.Role = Kart->Role;
+	SimulatedKart.RemoteRole = Kart->GetRemoteRole();
+	SimulatedKarts.Add(SimulatedKart);
+
+	if (bBatchedTick) SetComponentTicksEnabled(SimulatedKart, false);
+
+	AddInputPrerequisite(Kart->GetController());
+}
+
+void AGoKartManager::UnregisterKart(AGoKart* Kart)
+{
+	Bots.RemoveAllSwap([Kart](const FBot& Bot) { return Bot.Kart == Kart; });
+	Karts.RemoveSwap(Kart);
+	SimulatedKarts.RemoveAllSwap([Kart](const FSimulatedKart& SimulatedKart) { return SimulatedKart.Kart == Kart; });
+	RelevancyGrid.RemoveKart(Kart);
+}
+
+void AGoKartManager::SetComponentTicksEnabled(const FSimulatedKart& SimulatedKart, bool bEnabled)
+{
+	if (SimulatedKart.MovementComp != nullptr) SimulatedKart.MovementComp->SetComponentTickEnabled(bEnabled);
+	if (SimulatedKart.Replicator != nullptr) SimulatedKart.Replicator->SetComponentTickEnabled(bEnabled);
+}
+
+void AGoKartManager::UpdateBatchedTick()
+{
+	bool bWantBatchedTick = CVarBatchedTick.GetValueOnGameThread() != 0;
+	if (bWantBatchedTick == bBatchedTick) return;
+
+	bBatchedTick = bWantBatchedTick;
+	for (const FSimulatedKart& SimulatedKart : SimulatedKarts) SetComponentTicksEnabled(SimulatedKart, !bBatchedTick);
+}
+
+void AGoKartManager::TickSimulation(float DeltaTime)
+{
+	UpdateBots(DeltaTime);
+
+	UpdateBatchedTick();
+	if (!bBatchedTick) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_GoKart_ManagerSimulationTick);
+
+	bool bParallel = IsParallelServerSimulationActive();
+
+	// Karts making one move of their own this frame have their dynamics stepped together before any kart moves.
+	// Dynamics only read each kart's own state, so this matches stepping them one at a time.
+	BatchedMoves.Reset();
+	KartBatchedMoves.Reset();
+
+	for (FSimulatedKart& SimulatedKart : SimulatedKarts)
+	{
+		SimulatedKart.Role = SimulatedKart.Kart->Role;
+		SimulatedKart.RemoteRole = SimulatedKart.Kart->GetRemoteRole();
+
+		int32 MoveIndex = INDEX_NONE;
+		FBatchedMove Move;
+		float KartDeltaTime = DeltaTime * SimulatedKart.Kart->CustomTimeDilation;
+		if (SimulatedKart.MovementComp != nullptr && SimulatedKart.MovementComp->PrepareBatchedMove(KartDeltaTime, SimulatedKart.Role, SimulatedKart.RemoteRole, Move.Kart))
+		{
+			Move.Params = &SimulatedKart.MovementComp->GetDynamicsParams();
+			Move.bStepped = false;
+			MoveIndex = BatchedMoves.Add(Move);
+		}
+		KartBatchedMoves.Add(MoveIndex);
+	}
+
+	StepBatchedMoves();
+
+	// Every kart moves before any replicates, as the replicator's tick prerequisite on the movement component did.
+	// Moves are applied in registration order, so sweeps see the same karts moved as without batching.
+	for (int32 KartIndex = 0; KartIndex < SimulatedKarts.Num(); ++KartIndex)
+	{
+		FSimulatedKart& SimulatedKart = SimulatedKarts[KartIndex];
+
+		float KartDeltaTime = DeltaTime * SimulatedKart.Kart->CustomTimeDilation;
+		int32 MoveIndex = KartBatchedMoves[KartIndex];
+		if (MoveIndex != INDEX_NONE) SimulatedKart.MovementComp->FinishBatchedMove(BatchedMoves[MoveIndex].Kart);
+		else if (SimulatedKart.MovementComp != nullptr) SimulatedKart.MovementComp->TickMovement(KartDeltaTime, SimulatedKart.Role, SimulatedKart.RemoteRole);
+
+		// Client moves can only be simulated away from the actor when its collision is a primitive we can sweep
+		bool bExternal = bParallel && SimulatedKart.Role == ROLE_Authority && SimulatedKart.MovementComp != nullptr
+			&& Cast<UPrimitiveComponent>(SimulatedKart.Kart->GetRootComponent()) != nullptr;
+		if (SimulatedKart.Replicator != nullptr) SimulatedKart.Replicator->SetExternalServerSimulation(bExternal);
+	}
+
+	if (bParallel) SimulateServerMovesInParallel(DeltaTime);
+
+	ProxySmoothing.Reset();
+
+	for (const FSimulatedKart& SimulatedKart : SimulatedKarts)
+	{
+		float KartDeltaTime = DeltaTime * SimulatedKart.Kart->CustomTimeDilation;
+		if (SimulatedKart.Replicator != nullptr) SimulatedKart.Replicator->TickReplication(KartDeltaTime, SimulatedKart.Role, SimulatedKart.RemoteRole, &ProxySmoothing);
+	}
+
+	if (ProxySmoothing.Num() > 0)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_GoKart_ProxySmoothing);
+
+		ProxySmoothing.Evaluate();
+		ProxySmoothing.Apply();
+	}
+}
+
+void AGoKartManager::StepBatchedMoves()
+{
+	if (BatchedMoves.Num() == 0) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_GoKart_StepDynamicsBatch);
+
+	// Karts almost always share a handful of tunings, so gathering each group with a scan is cheaper than sorting
+	for (int32 First = 0; First < BatchedMoves.Num(); ++First)
+	{
+		if (BatchedMoves[First].bStepped) continue;
+
+		const FGoKartDynamicsParams* Params = BatchedMoves[First].Params;
+
+		DynamicsBatchMoves.Reset();
+		for (int32 Index = First; Index < BatchedMoves.Num(); ++Index)
+		{
+			if (!BatchedMoves[Index].bStepped && BatchedMoves[Index].Params == Params) DynamicsBatchMoves.Add(Index);
+		}
+
+		DynamicsBatch.Reset(DynamicsBatchMoves.Num());
+		for (int32 Index = 0; Index < DynamicsBatchMoves.Num(); ++Index) DynamicsBatch.SetKart(Index, BatchedMoves[DynamicsBatchMoves[Index]].Kart);
+
+		FGoKartDynamics::StepBatch(*Params, DynamicsBatch);
+
+		for (int32 Index = 0; Index < DynamicsBatchMoves.Num(); ++Index)
+		{
+			FBatchedMove& Move = BatchedMoves[DynamicsBatchMoves[Index]];
+			DynamicsBatch.GetKart(Index, Move.Kart);
+			Move.bStepped = true;
+		}
+	}
+}
+
+bool AGoKartManager::IsParallelServerSimulationActive() const
+{
+	return GetNetMode() != NM_Client && CVarParallelServerSimulation.GetValueOnGameThread() != 0 && SimulatedKarts.Num() >= CVarParallelMinKarts.GetValueOnGameThread();
+}
+
+void AGoKartManager::SimulateServerMovesInParallel(float DeltaTime)
+{
+	// Game thread: collect due moves and snapshot each kart's state and collision
+	int32 NumJobs = 0;
+	ServerSimKartLocations.Reset();
+
+	for (int32 KartIndex = 0; KartIndex < SimulatedKarts.Num(); ++KartIndex)
+	{
+		const FSimulatedKart& SimulatedKart = SimulatedKarts[KartIndex];
+		ServerSimKartLocations.Add(SimulatedKart.Kart->GetActorLocation());
+
+		// Karts without a movement component were left to simulate their own moves, like the serial path
+		if (SimulatedKart.Replicator == nullptr || SimulatedKart.MovementComp == nullptr || SimulatedKart.Role != ROLE_Authority) continue;
+
+		UPrimitiveComponent* Root = Cast<UPrimitiveComponent>(SimulatedKart.Kart->GetRootComponent());
+		if (Root == nullptr) continue;
+
+		if (ServerSimJobs.Num() <= NumJobs)
+		{
+			ServerSimJobs.AddDefaulted();
+			ServerSimJobKarts.AddDefaulted();
+		}
+
+		FGoKartServerSimJob& Job = ServerSimJobs[NumJobs];
+		SimulatedKart.Replicator->TakeServerMoves(DeltaTime * SimulatedKart.Kart->CustomTimeDilation, Job.Moves);
+		if (Job.Moves.Num() == 0) continue;
+
+		Job.Params = &SimulatedKart.MovementComp->GetDynamicsParams();
+		Job.Shape = Root->GetCollisionShape();
+		Job.Channel = Root->GetCollisionObjectType();
+		Job.QueryParams = FCollisionQueryParams(FName(TEXT("GoKartServerSimulation")), false, SimulatedKart.Kart);
+		Job.ResponseParams = FCollisionResponseParams(Root->GetCollisionResponseToChannels());
+		Job.TrackCollisionRadius = SimulatedKart.MovementComp->GetTrackCollisionRadius();
+		Job.ContactRewindTime = SimulatedKart.Replicator->GetContactRewindTime();
+		Job.KartIndex = KartIndex;
+		Job.Kart = SimulatedKart.Kart;
+		Job.Location = ServerSimKartLocations[KartIndex];
+		Job.Rotation = SimulatedKart.Kart->GetActorQuat();
+		Job.Velocity = SimulatedKart.MovementComp->GetVelocity();
+
+		ServerSimJobKarts[NumJobs] = KartIndex;
+		++NumJobs;
+	}
+
+	if (NumJobs == 0) return;
+
+	// Jobs past NumJobs are left over from busier frames and keep their move allocations
+	TArrayView<FGoKartServerSimJob> Jobs(ServerSimJobs.GetData(), NumJobs);
+	FGoKartServerSimulation::Simulate(GetWorld(), GetTrackCollision(), bRelevancyGridActive ? &RelevancyGrid : nullptr, ServerSimKartLocations, Jobs, FGoKartServerSimulation::GetMaxTasks());
+
+	// Game thread again: write back in a fixed order, so overlaps and server state do not depend on thread timing
+	for (int32 JobIndex = 0; JobIndex < NumJobs; ++JobIndex)
+	{
+		const FGoKartServerSimJob& Job = Jobs[JobIndex];
+		SimulatedKarts[ServerSimJobKarts[JobIndex]].Replicator->ApplyServerMoves(Job.Moves.Last(), Job.Location, Job.Rotation, Job.Velocity);
+	}
+}
+
+void AGoKartManager::AddInputPrerequisite(AController* Controller)
+{
+	// Kart components tick after their controller has processed input, so the batched tick has to as well
+	APlayerController* PlayerController = Cast<APlayerController>(Controller);
+	if (PlayerController != nullptr && PlayerController->IsLocalController()) SimulationTick.AddPrerequisite(PlayerController, PlayerController->PrimaryActorTick);
+}
+
+void AGoKartManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UpdateBatchedTick();
+
+#if GOKART_DEBUG_OVERLAY
+	if (GetNetMode() != NM_DedicatedServer) DebugOverlayHandle = UDebugDrawService::Register(TEXT("Game"), FDebugDrawDelegate::CreateUObject(this, &AGoKartManager::DrawDebugOverlay));
+#endif
+
+	// Clients predict with sweeps rather than each spend seconds baking, and the server corrects them as usual
+	if (GetNetMode() != NM_Client && CVarTrackCollisionGrid.GetValueOnGameThread() != 0) BakeTrackCollision();
+}
+
+void AGoKartManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+#if GOKART_DEBUG_OVERLAY
+	if (DebugOverlayHandle.IsValid()) UDebugDrawService::Unregister(DebugOverlayHandle);
+#endif
+
+	// Karts outliving us tick themselves again
+	if (bBatchedTick)
+	{
+		for (const FSimulatedKart& SimulatedKart : SimulatedKarts) SetComponentTicksEnabled(SimulatedKart, true);
+	}
+
+	Karts.Reset();
+	SimulatedKarts.Reset();
+	Bots.Reset();
+	RelevancyGrid.Reset();
+	TrackCollision.Reset();
+}
+
+int32 AGoKartManager::GetRelevantKartCount(const AActor* Kart) const
+{
+	int32 Count = bRelevancyGridActive ? RelevancyGrid.GetMaxRelevantCount(Kart) : 0;
+
+	// Before the grid has placed any viewer every connection receives every kart
+	return Count > 0 ? Count : Karts.Num();
+}
+
+bool AGoKartManager::IsNearOtherKart(const AActor* Kart, const FVector& Location, float Distance) const
+{
+	if (bRelevancyGridActive) return RelevancyGrid.IsOtherKartNear(Kart, Location, Distance);
+
+	float DistanceSquared = FMath::Square(Distance);
+	for (const AGoKart* Other : Karts)
+	{
+		if (Other != nullptr && Other != Kart && FVector::DistSquared(Other->GetActorLocation(), Location) < DistanceSquared) return true;
+	}
+	return false;
+}
+
+void AGoKartManager::BakeTrackCollision()
+{
+	// Bounds of everything a kart can not move through, skipping visual only meshes like the sky sphere
+	FBox Bounds(ForceInit);
+	for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+	{
+		if (It->IsA<AGoKart>()) continue;
+
+		TInlineComponentArray<UPrimitiveComponent*> Components;
+		It->GetComponents(Components);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			if (Component->IsCollisionEnabled() && Component->GetCollisionResponseToChannel(ECC_Pawn) == ECR_Block) Bounds += Component->Bounds.GetBox();
+		}
+	}
+
+	// The manager is spawned by the first kart, before any kart has registered, so find karts in the world
+	TArray<AActor*> IgnoredActors;
+	for (TActorIterator<AGoKart> Kart(GetWorld()); Kart; ++Kart) IgnoredActors.Add(*Kart);
+
+	TrackCollision.Bake(GetWorld(), Bounds, CVarTrackCollisionCellSize.GetValueOnGameThread(), CVarTrackCollisionMaxStepHeight.GetValueOnGameThread(), IgnoredActors);
+}
+
+void AGoKartManager::SpawnBots(int32 Count)
+{
+	if (RacingLine == nullptr)
+	{
+		TActorIterator<AGoKartRacingLine> It(GetWorld());
+		if (It) RacingLine = *It;
+	}
+
+	if (RacingLine == nullptr || !RacingLine->IsBaked())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Bots need an AGoKartRacingLine with a baked line in the level."));
+		return;
+	}
+
+	UClass* KartClass = LoadClass<AGoKart>(nullptr, *CVarBotKartClass.GetValueOnGameThread());
+	if (KartClass == nullptr) KartClass = AGoKart::StaticClass();
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	FRandomStream Random(Bots.Num());
+
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		FTransform Slot = RacingLine->GetGridSlot(Bots.Num());
+		AGoKart* Kart = GetWorld()->SpawnActor<AGoKart>(KartClass, Slot, SpawnParams);
+		UGoKartMovementComp* MovementComp = Kart != nullptr ? Kart->FindComponentByClass<UGoKartMovementComp>() : nullptr;
+		if (MovementComp == nullptr) continue;
+
+		// Unpossessed karts on the server make their own moves from throttle and steering, so no RPCs are involved
+		FBot Bot;
+		Bot.Kart = Kart;
+		Bot.MovementComp = MovementComp;
+		Bot.Distance = RacingLine->FindDistance(Kart->GetActorLocation(), 0.0f, RacingLine->GetLength());
+		Bot.SpeedScale = Random.FRandRange(0.85f, 1.0f);
+		Bots.Add(Bot);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("%d bots on the racing line"), Bots.Num());
+}
+
+void AGoKartManager::DestroyBots()
+{
+	// Destroying unregisters each kart, which removes its bot
+	TArray<FBot> BotsToDestroy = Bots;
+	for (const FBot& Bot : BotsToDestroy) Bot.Kart->Destroy();
+	Bots.Reset();
+}
+
+void AGoKartManager::UpdateBots(float DeltaTime)
+{
+	if (Bots.Num() == 0 || RacingLine == nullptr || !RacingLine->IsBaked()) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_GoKart_UpdateBots);
+
+	const float LookAheadTime = CVarBotLookAheadTime.GetValueOnGameThread();
+	const float MinLookAhead = CVarBotMinLookAhead.GetValueOnGameThread();
+
+	for (FBot& Bot : Bots)
+	{
+		const FTransform& Transform = Bot.Kart->GetActorTransform();
+		FVector Location = Transform.GetLocation();
+		FVector Forward = Transform.GetUnitAxis(EAxis::X);
+
+		// m/s, m/s * 100 = cm/s
+		float Speed = FVector::DotProduct(Bot.MovementComp->GetVelocity(), Forward);
+		float Travel = FMath::Abs(Speed) * 100 * DeltaTime;
+
+		// Progress only moves a frame's travel, so a few samples either side of last frame's is enough
+		Bot.Distance = RacingLine->FindDistance(Location, Bot.Distance, Travel + 200.0f);
+
+		float LookAhead = FMath::Max(MinLookAhead, FMath::Abs(Speed) * 100 * LookAheadTime);
+		FVector Target = Transform.InverseTransformVectorNoScale(RacingLine->GetLocation(Bot.Distance + LookAhead) - Location);
+		const FGoKartRacingLineSample& Ahead = RacingLine->GetSample(Bot.Distance + LookAhead * 0.5f);
+
+		// Pure pursuit: the arc through the target point has curvature 2y / d^2 (cm to m), and full lock turns at MinTurningRadius
+		float DistanceSquared = FMath::Max(Target.SizeSquared(), 1.0f);
+		float Curvature = 2.0f * Target.Y / DistanceSquared * 100.0f;
+		float SteeringThrow = Curvature * Bot.MovementComp->GetDynamicsParams().MinTurningRadius;
+
+		float TargetSpeed = Ahead.TargetSpeed * Bot.SpeedScale;
+		float Throttle = (TargetSpeed - Speed) * 0.5f;
+
+		// Facing away from the line: crawl round at full lock
+		if (Target.X < 0)
+		{
+			SteeringThrow = Target.Y >= 0 ? 1.0f : -1.0f;
+			Throttle = 0.3f;
+		}
+
+		Bot.MovementComp->SetThrottle(FMath::Clamp(Throttle, -1.0f, 1.0f));
+		Bot.MovementComp->SetSteeringThrow(FMath::Clamp(SteeringThrow, -1.0f, 1.0f));
+	}
+}
+
+void AGoKartManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (GetNetMode() == NM_DedicatedServer || GetNetMode() == NM_ListenServer) UpdateRelevancy(DeltaTime);
+}
+
+void AGoKartManager::UpdateRelevancy(float DeltaTime)
+{
+	bool bWasActive = bRelevancyGridActive;
+	bRelevancyGridActive = CVarRelevancyGrid.GetValueOnGameThread() != 0;
+
+	if (!bRelevancyGridActive)
+	{
+		if (bWasActive) RelevancyGrid.Reset();
+		return;
+	}
+
+	RelevancyGrid.Configure(CVarRelevancyCellSize.GetValueOnGameThread(), CVarRelevancyViewRadius.GetValueOnGameThread(), CVarRelevancyMaxFullRateKarts.GetValueOnGameThread());
+
+	for (AGoKart* Kart : Karts)
+	{
+		if (Kart != nullptr) RelevancyGrid.UpdateKart(Kart, Kart->GetActorLocation());
+	}
+
+	// Karts move within a cell too, so re-pick each viewer's nearest karts twice a second
+	const float FullRateRefreshInterval = 0.5f;
+	TimeSinceFullRateRefresh += DeltaTime;
+	bool bRefreshFullRate = TimeSinceFullRateRefresh >= FullRateRefreshInterval;
+	if (bRefreshFullRate) TimeSinceFullRateRefresh = 0;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (PlayerController == nullptr) continue;
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+		RelevancyGrid.UpdateViewer(PlayerController, ViewLocation, bRefreshFullRate);
+	}
+
+	RelevancyGrid.EndUpdate();
+}
+
+#if GOKART_DEBUG_OVERLAY
+void AGoKartManager::DrawDebugOverlay(UCanvas* Canvas, APlayerController* PlayerController)
+{
+	// The draw service is shared by every world, e.g. each PIE client
+	if (PlayerController == nullptr || PlayerController->GetWorld() != GetWorld()) return;
+
+	FGoKartDebugOverlay::Draw(Canvas, PlayerController, Karts);
+}
+#endif
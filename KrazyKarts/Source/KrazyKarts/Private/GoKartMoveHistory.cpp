@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartMoveHistory.h"
+
+bool FGoKartMoveHistory::Add(const FGoKartMove& Move)
+{
+	checkSlow(Count == 0 || (int32)(Move.Sequence - (*this)[Count - 1].Sequence) > 0);
+
+	bool bHadRoom = Count < Capacity;
+	if (!bHadRoom)
+	{
+		Head = (Head + 1) & (Capacity - 1);
+		--Count;
+		++OverflowCount;
+	}
+
+	Moves[(Head + Count) & (Capacity - 1)] = Move;
+	++Count;
+
+	return bHadRoom;
+}
+
+void FGoKartMoveHistory::AcknowledgeThrough(uint32 Sequence)
+{
+	if (Count == 0) return;
+
+	// Signed distance so sequence wrap-around still compares correctly
+	int32 NumAcknowledged = (int32)(Sequence - Moves[Head].Sequence) + 1;
+	NumAcknowledged = FMath::Clamp(NumAcknowledged, 0, Count);
+
+	// Only runs when there are gaps in the sequence
+	while (NumAcknowledged > 0 && (int32)((*this)[NumAcknowledged - 1].Sequence - Sequence) > 0) --NumAcknowledged;
+
+	Head = (Head + NumAcknowledged) & (Capacity - 1);
+	Count -= NumAcknowledged;
+}
+
+FGoKartMove FGoKartMoveHistory::PopOldest()
+{
+	check(Count > 0);
+
+	FGoKartMove Move = Moves[Head];
+	Head = (Head + 1) & (Capacity - 1);
+	--Count;
+
+	return Move;
+}
+
+void FGoKartMoveHistory::Reset()
+{
+	Head = 0;
+	Count = 0;
+}
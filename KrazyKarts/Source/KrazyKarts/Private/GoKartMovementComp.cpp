@@ -2,6 +2,12 @@
 
 #include "GoKartMovementComp.h"
 
+#include "GoKartStats.h"
+#include "GoKartManager.h"
+#include "GoKartRecording.h"
+#include "GoKartStateHistory.h"
+#include "GoKartTuning.h"
+
 
 // Sets default values for this component's properties
 UGoKartMovementComp::UGoKartMovementComp()
@@ -19,8 +25,24 @@ void UGoKartMovementComp::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// ...
-	
+	PreviousStepTransform = GetOwner()->GetActorTransform();
+
+	Manager = AGoKartManager::Get(GetWorld());
+
+	UpdateDynamicsParams();
+
+	// Local space extent, so the radius does not depend on which way the kart spawned facing
+	USceneComponent* Root = GetOwner()->GetRootComponent();
+	FVector Extent = Root != nullptr ? Root->CalcBounds(FTransform::Identity).BoxExtent : FVector(100.0f);
+	TrackCollisionRadius = FMath::Min(Extent.X, Extent.Y);
+}
+
+void UGoKartMovementComp::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	// A kart spawned later may reuse this component's memory, and must be recorded as a new kart
+	FGoKartRecorder::RemoveKart(this);
 }
 
 
@@ -29,28 +51,156 @@ void UGoKartMovementComp::TickComponent(float DeltaTime, ELevelTick TickType, FA
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-	if (GetOwnerRole() == ROLE_AutonomousProxy || GetOwner()->GetRemoteRole() == ROLE_SimulatedProxy)
+	TickMovement(DeltaTime, GetOwnerRole(), GetOwner()->GetRemoteRole());
+}
+
+void UGoKartMovementComp::TickMovement(float DeltaTime, ENetRole Role, ENetRole RemoteRole)
+{
+	NewMoves.Reset();
+	NewMoveStates.Reset();
+
+	if (bExternalMoveSource) return;
+
+	if (Role == ROLE_AutonomousProxy || RemoteRole == ROLE_SimulatedProxy)
 	{
+		if (bUseFixedTimestep)
+		{
+			TickFixedStep(DeltaTime);
+			return;
+		}
+
 		LastMove = CreateMove(DeltaTime);
-		SimulateMove(LastMove);
+		SimulateNewMove(LastMove);
 	}
 }
 
-void UGoKartMovementComp::SimulateMove(const FGoKartMove & Move)
+void UGoKartMovementComp::TickFixedStep(float DeltaTime)
 {
-	FVector Force = GetOwner()->GetActorForwardVector() * MaxDrivingForce * Move.Throttle;
-	// Applying the air drag to the Force
-	Force += GetAirResistance();
-	// Applying the rolling resistance to the Force
-	Force += GetRollingResistance();
-	// a = F / m
-	FVector Acceleration = Force / Mass;
-	// dv = a * dt
-	Velocity += Acceleration * Move.DeltaTime;
+	const float StepTime = 1.0f / FixedStepRate;
+	int32 Steps = 0;
+
+	StepAccumulator += DeltaTime;
+
+	while (StepAccumulator >= StepTime && Steps < MaxStepsPerFrame)
+	{
+		StepAccumulator -= StepTime;
+		++Steps;
 
-	ApplyRotation(Move.DeltaTime, Move.SteeringThrow);
+		PreviousStepTransform = GetOwner()->GetActorTransform();
 
-	UpdateLocationFromVelocity(Move.DeltaTime);
+		LastMove = CreateMove(StepTime);
+		// Stamp each move with the end of its step so moves created in one frame stay in order
+		LastMove.Time -= StepAccumulator;
+		SimulateNewMove(LastMove);
+	}
+
+	// Drop the time we could not catch up on
+	if (Steps == MaxStepsPerFrame) StepAccumulator = FMath::Min(StepAccumulator, StepTime);
+}
+
+bool UGoKartMovementComp::PrepareBatchedMove(float DeltaTime, ENetRole Role, ENetRole RemoteRole, FGoKartDynamicsKart& OutKart)
+{
+	// Fixed steps in one frame each start from the step before, so can not be stepped side by side
+	if (bExternalMoveSource || bUseFixedTimestep) return false;
+	if (Role != ROLE_AutonomousProxy && RemoteRole != ROLE_SimulatedProxy) return false;
+
+	NewMoves.Reset();
+	NewMoveStates.Reset();
+
+	LastMove = CreateMove(DeltaTime);
+	MakeDynamicsKart(LastMove, OutKart);
+	return true;
+}
+
+void UGoKartMovementComp::FinishBatchedMove(const FGoKartDynamicsKart& Kart)
+{
+	GOKART_SCOPE_CYCLE_COUNTER(SimulateMove);
+	GOKART_INC_COUNTER(MovesSimulated, 1);
+
+	ApplyDynamicsStep(Kart, true);
+
+	RecordNewMove(LastMove);
+}
+
+void UGoKartMovementComp::SimulateNewMove(const FGoKartMove& Move)
+{
+	SimulateMove(Move);
+
+	RecordNewMove(Move);
+}
+
+void UGoKartMovementComp::RecordNewMove(const FGoKartMove& Move)
+{
+	FGoKartPredictedState State;
+	State.Sequence = Move.Sequence;
+	State.Location = GetOwner()->GetActorLocation();
+	State.Rotation = GetOwner()->GetActorQuat();
+	State.Velocity = Velocity;
+
+	NewMoves.Add(Move);
+	NewMoveStates.Add(State);
+}
+
+void UGoKartMovementComp::SimulateMove(const FGoKartMove & Move, bool bSweep)
+{
+	GOKART_SCOPE_CYCLE_COUNTER(SimulateMove);
+	GOKART_INC_COUNTER(MovesSimulated, 1);
+
+	FGoKartDynamicsKart Kart;
+	MakeDynamicsKart(Move, Kart);
+
+	FGoKartDynamics::Step(GetDynamicsParams(), Kart);
+
+	ApplyDynamicsStep(Kart, bSweep);
+}
+
+void UGoKartMovementComp::MakeDynamicsKart(const FGoKartMove& Move, FGoKartDynamicsKart& OutKart) const
+{
+	OutKart.Velocity = Velocity;
+	OutKart.Forward = GetOwner()->GetActorForwardVector();
+	OutKart.Up = GetOwner()->GetActorUpVector();
+	OutKart.Throttle = Move.Throttle;
+	OutKart.SteeringThrow = Move.SteeringThrow;
+	OutKart.DeltaTime = Move.DeltaTime;
+}
+
+void UGoKartMovementComp::ApplyDynamicsStep(const FGoKartDynamicsKart& Kart, bool bSweep)
+{
+	Velocity = Kart.Velocity;
+
+	ApplyRotation(Kart.Up, Kart.RotationAngle);
+
+	UpdateLocationFromVelocity(Kart.Translation, bSweep);
+}
+
+const FGoKartDynamicsParams& UGoKartMovementComp::GetDynamicsParams() const
+{
+	return bWorldGravityOverride ? WorldGravityParams : GetTuning()->GetParams();
+}
+
+const UGoKartTuning* UGoKartMovementComp::GetTuning() const
+{
+	return Tuning != nullptr ? Tuning : GetDefault<UGoKartTuning>();
+}
+
+void UGoKartMovementComp::SetTuning(UGoKartTuning* InTuning)
+{
+	Tuning = InTuning;
+
+	if (HasBegunPlay()) UpdateDynamicsParams();
+}
+
+void UGoKartMovementComp::UpdateDynamicsParams()
+{
+	const FGoKartDynamicsParams& Params = GetTuning()->GetParams();
+	float GravityZ = GetWorld()->GetGravityZ();
+
+	bWorldGravityOverride = GravityZ != Params.GravityZ;
+	if (!bWorldGravityOverride) return;
+
+	WorldGravityParams = Params;
+	WorldGravityParams.GravityZ = GravityZ;
+	WorldGravityParams.UpdateDerived();
 }
 
 FGoKartMove UGoKartMovementComp::CreateMove(float DeltaTime)
@@ -60,42 +210,78 @@ FGoKartMove UGoKartMovementComp::CreateMove(float DeltaTime)
 	Move.SteeringThrow = SteeringThrow;
 	Move.Throttle = Throttle;
 	Move.Time = GetWorld()->TimeSeconds;
+	Move.Sequence = NextMoveSequence++;
 
 	return Move;
 }
 
-FVector UGoKartMovementComp::GetAirResistance()
+void UGoKartMovementComp::ApplyRotation(const FVector& Axis, float RotationAngle)
 {
-	return -Velocity.GetSafeNormal() * Velocity.SizeSquared() * DragCoef;
+	FQuat RotationDelta(Axis, RotationAngle);
+
+	GetOwner()->AddActorWorldRotation(RotationDelta);
 }
 
-FVector UGoKartMovementComp::GetRollingResistance()
+void UGoKartMovementComp::UpdateLocationFromVelocity(const FVector& Translation, bool bSweep)
 {
-	float AccelerationDueToGravity = -GetWorld()->GetGravityZ() / 100.0f;
-	float NormalForce = Mass * AccelerationDueToGravity;
+	if (bSweep && MoveWithTrackCollision(Translation)) return;
+
+	FHitResult Hit;
+
+	if (bSweep) GOKART_INC_COUNTER(Sweeps, 1);
 
-	return -Velocity.GetSafeNormal() * RollingResistanceCoef * NormalForce;
+	FVector Start = GetOwner()->GetActorLocation();
+	GetOwner()->AddActorWorldOffset(Translation, bSweep, &Hit);
+	if (Hit.IsValidBlockingHit() && ContactRewindTime > 0.0f) SweepPastUnseenKart(Start, Translation, Hit);
+	if (Hit.IsValidBlockingHit()) Velocity = FVector::ZeroVector;
 }
 
-void UGoKartMovementComp::ApplyRotation(float DeltaTime, float InSteeringThrow)
+void UGoKartMovementComp::SweepPastUnseenKart(const FVector& Start, const FVector& Translation, FHitResult& Hit)
 {
-	float DeltaLocation = FVector::DotProduct(GetOwner()->GetActorForwardVector(), Velocity) * DeltaTime;
-	float RotationAngle = DeltaLocation / MinTurningRadius * InSteeringThrow;
-	FQuat RotationDelta(GetOwner()->GetActorUpVector(), RotationAngle);
+	AActor* Other = Hit.GetActor();
+	UPrimitiveComponent* Root = Cast<UPrimitiveComponent>(GetOwner()->GetRootComponent());
+	if (Other == nullptr || Root == nullptr) return;
 
-	// Rotating our velocity as we rotate the car
-	Velocity = RotationDelta.RotateVector(Velocity);
+	if (FGoKartLagCompensation::WouldHitRewound(Other, GetWorld()->TimeSeconds - ContactRewindTime, Start, Translation, TrackCollisionRadius)) return;
 
-	GetOwner()->AddActorWorldRotation(RotationDelta);
+	GOKART_INC_COUNTER(Sweeps, 1);
+
+	Root->IgnoreActorWhenMoving(Other, true);
+	GetOwner()->AddActorWorldOffset(Start + Translation - GetOwner()->GetActorLocation(), true, &Hit);
+
+	// Passing through can end the move inside Other, whose own sweeps would then start inside us and stop it
+	// dead every move until we leave. Push back out, still ignoring Other so only the rest of the world stops us.
+	UPrimitiveComponent* OtherRoot = Cast<UPrimitiveComponent>(Other->GetRootComponent());
+	FMTDResult Penetration;
+	if (OtherRoot != nullptr && OtherRoot->ComputePenetration(Penetration, Root->GetCollisionShape(), Root->GetComponentLocation(), Root->GetComponentQuat()))
+	{
+		GOKART_INC_COUNTER(Sweeps, 1);
+		GetOwner()->AddActorWorldOffset(Penetration.Direction * (Penetration.Distance + 0.1f), true);
+	}
+
+	Root->IgnoreActorWhenMoving(Other, false);
 }
 
-void UGoKartMovementComp::UpdateLocationFromVelocity(float DeltaTime)
+bool UGoKartMovementComp::IsTrackCollisionAvailable() const
 {
-	FHitResult Hit;
-	// MPS * 100 = CMPS * S = Velocity in CM.
-	FVector Translation = Velocity * 100 * DeltaTime;
-
-	GetOwner()->AddActorWorldOffset(Translation, true, &Hit);
-	if (Hit.IsValidBlockingHit()) Velocity = FVector::ZeroVector;
+	return Manager != nullptr && Manager->GetTrackCollision() != nullptr;
 }
 
+bool UGoKartMovementComp::MoveWithTrackCollision(const FVector& Translation)
+{
+	if (!IsTrackCollisionAvailable()) return false;
+
+	FVector Start = GetOwner()->GetActorLocation();
+
+	// Other karts are not in the grid, leave moves that could reach one to the sweep
+	if (Manager->IsNearOtherKart(GetOwner(), Start, Translation.Size() + TrackCollisionRadius * 4.0f)) return false;
+
+	float Time;
+	FGoKartTrackCollision::EMoveResult Result = Manager->GetTrackCollision()->Move(Start, Translation, TrackCollisionRadius, Time);
+	if (Result == FGoKartTrackCollision::EMoveResult::Unknown) return false;
+
+	GetOwner()->AddActorWorldOffset(Translation * Time);
+	if (Result == FGoKartTrackCollision::EMoveResult::Blocked) Velocity = FVector::ZeroVector;
+
+	return true;
+}
@@ -4,7 +4,88 @@
 
 #include "UnrealNetwork.h"
 #include "GameFramework/Actor.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerState.h"
+#include "EngineUtils.h"
+#include "Serialization/BitWriter.h"
+#include "HAL/IConsoleManager.h"
+#include "GoKartManager.h"
+#include "GoKartNetQuantize.h"
+#include "GoKartRecording.h"
+#include "GoKartStats.h"
+
+
+bool FGoKartState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	FVector Location = Transform.GetLocation();
+	FQuat Rotation = Transform.GetRotation();
+
+	FGoKartNetQuantize::SerializeVector(Ar, Location, FGoKartNetQuantize::GetPositionResolution());
+	FGoKartNetQuantize::SerializeRotation(Ar, Rotation);
+	FGoKartNetQuantize::SerializeVector(Ar, Velocity, FGoKartNetQuantize::GetVelocityResolution());
+
+	Ar.SerializeIntPacked(LastMove.Sequence);
+	Ar << LastMove.Time;
+	Ar << LastMove.DeltaTime;
+	Ar << ServerTime;
+	FGoKartNetQuantize::SerializeUnitFloat(Ar, LastMove.Throttle);
+	FGoKartNetQuantize::SerializeUnitFloat(Ar, LastMove.SteeringThrow);
 
+	// Karts are never scaled, so scale is not sent
+	if (Ar.IsLoading()) Transform = FTransform(Rotation, Location);
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+// Compares the bits each replicated kart state costs with and without quantization
+static void ReportStateSize(UWorld* World)
+{
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		UGoKartMovementReplicator* Replicator = It->FindComponentByClass<UGoKartMovementReplicator>();
+		if (Replicator == nullptr || Replicator->MovementComp == nullptr) continue;
+
+		FGoKartState State;
+		State.Transform = It->GetActorTransform();
+		State.Velocity = Replicator->MovementComp->GetVelocity();
+		State.LastMove = Replicator->MovementComp->GetLastMove();
+
+		FBitWriter FullPrecision(0, true);
+		FullPrecision << State.Transform << State.Velocity << State.LastMove.Throttle << State.LastMove.SteeringThrow;
+		FullPrecision << State.LastMove.DeltaTime << State.LastMove.Time << State.LastMove.Sequence << State.ServerTime;
+
+		FBitWriter Quantized(0, true);
+		bool bSuccess = true;
+		State.NetSerialize(Quantized, nullptr, bSuccess);
+
+		UE_LOG(LogTemp, Display, TEXT("%s: full precision %lld bytes, quantized %lld bits (%lld bytes)"), *It->GetName(),
+			FullPrecision.GetNumBytes(), Quantized.GetNumBits(), Quantized.GetNumBytes());
+	}
+}
+
+static FAutoConsoleCommandWithWorld ReportStateSizeCommand(
+	TEXT("kart.Net.ReportStateSize"),
+	TEXT("Logs the replicated FGoKartState size of every kart, before and after quantization."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&ReportStateSize));
+
+// Logs how many of each kart's client moves the server time bank and rate limit had to shorten, drop or merge
+static void ReportMoveLimits(UWorld* World)
+{
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		UGoKartMovementReplicator* Replicator = It->FindComponentByClass<UGoKartMovementReplicator>();
+		if (Replicator == nullptr || It->Role != ROLE_Authority) continue;
+
+		UE_LOG(LogTemp, Display, TEXT("%s: %u moves received, %u clamped, %u dropped, %u merged"), *It->GetName(),
+			Replicator->GetServerMovesReceived(), Replicator->GetServerMovesClamped(), Replicator->GetServerMovesDropped(), Replicator->GetServerMovesMerged());
+	}
+}
+
+static FAutoConsoleCommandWithWorld ReportMoveLimitsCommand(
+	TEXT("kart.Net.ReportMoveLimits"),
+	TEXT("Logs the client moves each kart's server time bank and move rate limit clamped, dropped or merged."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&ReportMoveLimits));
 
 // Sets default values for this component's properties
 UGoKartMovementReplicator::UGoKartMovementReplicator()
@@ -23,6 +104,21 @@ void UGoKartMovementReplicator::BeginPlay()
 	Super::BeginPlay();
 
 	MovementComp = GetOwner()->FindComponentByClass<UGoKartMovementComp>();
+
+	// Consume the moves the movement component created this frame, not last frame's
+	if (MovementComp != nullptr) AddTickPrerequisiteComponent(MovementComp);
+
+	if (GetOwnerRole() == ROLE_Authority && bAdaptiveNetUpdateRate)
+	{
+		GetOwner()->NetUpdateFrequency = MinNetUpdateRate;
+		GetOwner()->MinNetUpdateFrequency = MinNetUpdateRate;
+		NetRateLastLocation = GetOwner()->GetActorLocation();
+		Manager = AGoKartManager::Get(GetWorld());
+	}
+
+	// Start full, so the first moves after spawning are not held back
+	ServerMoveTimeBank = MaxMoveTimeBank;
+	ServerMoveTokens = MaxMoveBurst;
 }
 
 
@@ -31,24 +127,108 @@ void UGoKartMovementReplicator::TickComponent(float DeltaTime, ELevelTick TickTy
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
+	TickReplication(DeltaTime, GetOwnerRole(), GetOwner()->GetRemoteRole());
+}
+
+void UGoKartMovementReplicator::TickReplication(float DeltaTime, ENetRole Role, ENetRole RemoteRole, FGoKartProxySmoothingBatch* ProxyBatch)
+{
 	if (MovementComp == nullptr) return;
 
-	FGoKartMove LastMove = MovementComp->GetLastMove();
+	const TArray<FGoKartMove>& NewMoves = MovementComp->GetNewMoves();
+	for (int32 Index = 0; Index < NewMoves.Num(); ++Index)
+	{
+		const FGoKartMove& Move = NewMoves[Index];
+
+		if (Role == ROLE_AutonomousProxy)
+		{
+			PredictedStates[Move.Sequence & (FGoKartMoveHistory::Capacity - 1)] = MovementComp->GetNewMoveStates()[Index];
+
+			if (!UnacknowledgedMoves.Add(Move) && !bUnacknowledgedMovesOverflowed)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Unacknowledged move history is full, dropping oldest moves."));
+				bUnacknowledgedMovesOverflowed = true;
+			}
+			if (!bBatchMoveUpload) Server_SendMove(Move);
+		}
+
+		// We are the server and in control of the pawn
+		if (RemoteRole == ROLE_SimulatedProxy) UpdateServerState(Move);
+	}
 
-	if (GetOwnerRole() == ROLE_AutonomousProxy)
+	if (Role == ROLE_AutonomousProxy) GOKART_INC_COUNTER(UnacknowledgedMoves, UnacknowledgedMoves.Num());
+
+	if (Role == ROLE_AutonomousProxy && bBatchMoveUpload)
+	{
+		MoveSendAccumulator += DeltaTime;
+		if (MoveSendAccumulator >= 1.0f / MoveSendRate)
+		{
+			MoveSendAccumulator = FMath::Fmod(MoveSendAccumulator, 1.0f / MoveSendRate);
+			SendMoveBatch();
+		}
+	}
+
+	if (Role == ROLE_Authority)
 	{
-		UnacknowledgedMoves.Add(LastMove);
-		Server_SendMove(LastMove);
+		TickMoveLimits(DeltaTime);
+		MovementComp->SetContactRewindTime(GetContactRewindTime());
 	}
 
-	// We are the server and in control of the pawn
-	if (GetOwner()->GetRemoteRole() == ROLE_SimulatedProxy) UpdateServerState(LastMove);
+	if (Role == ROLE_Authority && bQueueServerMoves && !bExternalServerSimulation) TickServerMoveQueue(DeltaTime);
+
+	if (Role == ROLE_Authority && bAdaptiveNetUpdateRate) UpdateNetUpdateRate(DeltaTime);
+
+	// Only karts UGoKartMovementComp::TickMovement steps here have fixed steps to blend between. The server's
+	// copy of a client's kart moves by received moves instead.
+	if (Role == ROLE_SimulatedProxy) ClientTick(DeltaTime, ProxyBatch);
+	else UpdateLocalMesh(DeltaTime, Role == ROLE_AutonomousProxy || RemoteRole == ROLE_SimulatedProxy);
+}
+
+void UGoKartMovementReplicator::UpdateNetUpdateRate(float DeltaTime)
+{
+	// Rate changes only matter at replication granularity, so don't recompute every frame
+	const float RateUpdateInterval = 0.25f;
+
+	NetRateTimeSinceUpdate += DeltaTime;
+	if (NetRateTimeSinceUpdate < RateUpdateInterval) return;
+
+	FVector Location = GetOwner()->GetActorLocation();
+	FVector Velocity = MovementComp->GetVelocity();
+
+	// Where a simulated proxy extrapolating from our last sample would think we are (m/s * 100 = cm/s)
+	FVector DeadReckonedLocation = NetRateLastLocation + NetRateLastVelocity * 100 * NetRateTimeSinceUpdate;
+	float PredictionError = FVector::Dist(DeadReckonedLocation, Location);
+
+	NetRateLastLocation = Location;
+	NetRateLastVelocity = Velocity;
+	NetRateTimeSinceUpdate = 0;
+
+	const FGoKartMove& LastMove = ServerState.LastMove;
+	NetActivity = FMath::Max3(Velocity.Size() / FullRateSpeed, FMath::Abs(LastMove.SteeringThrow), PredictionError / FullRateError);
+	NetActivity = FMath::Clamp(NetActivity, 0.0f, 1.0f);
+
+	// Each kart gets an even share of the budget of the most crowded connection receiving it. The update rate
+	// is shared by every connection, so that one bounds it.
+	int32 NumKarts = FMath::Max(1, Manager != nullptr ? Manager->GetRelevantKartCount(GetOwner()) : GetWorld()->GetNumPawns());
+	float AffordableRate = ConnectionBandwidthBudget / (NumKarts * EstimatedUpdateBytes);
+	float MaxRate = FMath::Max(MinNetUpdateRate, FMath::Min(MaxNetUpdateRate, AffordableRate));
+
+	GetOwner()->NetUpdateFrequency = FMath::Lerp(MinNetUpdateRate, MaxRate, NetActivity);
+}
+
+float UGoKartMovementReplicator::GetNetPriorityScale(const FVector& ViewPos) const
+{
+	float Distance = FVector::Dist(ViewPos, GetOwner()->GetActorLocation());
+	float DistanceScale = FMath::Clamp(FullPriorityDistance / FMath::Max(Distance, 1.0f), 0.1f, 1.0f);
 
-	if (GetOwnerRole() == ROLE_SimulatedProxy) ClientTick(DeltaTime);
+	// Parked karts still get some priority so they are not starved forever
+	return DistanceScale * (0.25f + NetActivity);
 }
 
 void UGoKartMovementReplicator::OnRep_ServerState()
 {
+	if (ClientLastServerTime > 0) ClientUpdateInterval = ServerState.ServerTime - ClientLastServerTime;
+	ClientLastServerTime = ServerState.ServerTime;
+
 	switch (GetOwnerRole())
 	{
 	case ROLE_AutonomousProxy:
@@ -62,10 +242,63 @@ void UGoKartMovementReplicator::OnRep_ServerState()
 	}
 }
 
+void UGoKartMovementReplicator::TakeErrorStats(FGoKartNetErrorStats& OutStats)
+{
+	OutStats.Accumulate(ErrorStats);
+	ErrorStats = FGoKartNetErrorStats();
+}
+
+float UGoKartMovementReplicator::GetUpdateInterval() const
+{
+	if (GetOwnerRole() == ROLE_Authority) return 1.0f / FMath::Max(GetOwner()->NetUpdateFrequency, 0.01f);
+
+	return ClientUpdateInterval;
+}
+
 void UGoKartMovementReplicator::SimulatedProxy_OnRep_ServerState()
 {
 	if (MovementComp == nullptr) return;
 
+	if (bUseSnapshotInterpolation)
+	{
+		FGoKartSnapshot Snapshot;
+		Snapshot.Time = ServerState.ServerTime;
+		Snapshot.Location = ServerState.Transform.GetLocation();
+		Snapshot.Rotation = ServerState.Transform.GetRotation();
+		Snapshot.Velocity = ServerState.Velocity;
+
+		// Only a proxy extrapolating past its newest snapshot can have been drawn in the wrong place
+		FGoKartSnapshot Drawn, Actual;
+		bool bExtrapolating = ClientSnapshots.Num() > 0 && ClientRenderTime > ClientSnapshots.Newest().Time && ClientSnapshots.Sample(ClientRenderTime, MaxExtrapolationTime, Drawn);
+
+		if (ClientSnapshots.Num() > 0)
+		{
+			float Interval = Snapshot.Time - ClientSnapshots.Newest().Time;
+			if (Interval > 0) ClientSnapshotInterval += (Interval - ClientSnapshotInterval) * 0.1f;
+		}
+		else
+		{
+			ClientRenderTime = Snapshot.Time - InterpolationDelay;
+		}
+
+		ClientSnapshots.Add(Snapshot);
+
+		float ProxyError = bExtrapolating && ClientSnapshots.Sample(ClientRenderTime, MaxExtrapolationTime, Actual) ? FVector::Dist(Drawn.Location, Actual.Location) : 0.0f;
+		++ErrorStats.ProxyUpdates;
+		ErrorStats.TotalProxyError += ProxyError;
+		ErrorStats.MaxProxyError = FMath::Max(ErrorStats.MaxProxyError, ProxyError);
+
+		GetOwner()->SetActorTransform(ServerState.Transform);
+		return;
+	}
+
+	// The actor has already snapped to the last update, so measure from where the mesh was actually drawn
+	FVector DrawnLocation = MeshOffsetRoot != nullptr ? MeshOffsetRoot->GetComponentLocation() : GetOwner()->GetActorLocation();
+	float ProxyError = ClientTimeBetweenLastUpdates > 0 ? FVector::Dist(DrawnLocation, ServerState.Transform.GetLocation()) : 0.0f;
+	++ErrorStats.ProxyUpdates;
+	ErrorStats.TotalProxyError += ProxyError;
+	ErrorStats.MaxProxyError = FMath::Max(ErrorStats.MaxProxyError, ProxyError);
+
 	ClientTimeBetweenLastUpdates = ClientTimeSinceUpdate;
 
 	ClientTimeSinceUpdate = 0;
@@ -76,117 +309,580 @@ void UGoKartMovementReplicator::SimulatedProxy_OnRep_ServerState()
 		ClientStartTransform.SetRotation(MeshOffsetRoot->GetComponentQuat());
 	}
 
-	ClientStartVelocity = MovementComp->GetVelocity();
+	float DerivativeScale = VelocityToDerivative();
+	ClientSpline = FHermiteCubicSpline(ClientStartTransform.GetLocation(), MovementComp->GetVelocity() * DerivativeScale, ServerState.Transform.GetLocation(), ServerState.Velocity * DerivativeScale);
+	ClientInvDerivativeScale = DerivativeScale > KINDA_SMALL_NUMBER ? 1.0f / DerivativeScale : 0.0f;
 
 	GetOwner()->SetActorTransform(ServerState.Transform);
 }
 
 void UGoKartMovementReplicator::AutonomousProxy_OnRep_ServerState()
 {
+	GOKART_SCOPE_CYCLE_COUNTER(AutonomousProxyOnRep);
+
 	if (MovementComp == nullptr) return;
 
+	bool bPredictionCorrect = IsPredictionCorrect();
+
+	ClearAcknowledgedMoves(ServerState.LastMove);
+
+	if (bPredictionCorrect) return;
+
+	FVector PredictedLocation = GetOwner()->GetActorLocation();
+	FTransform MeshTransform = MeshOffsetRoot != nullptr ? MeshOffsetRoot->GetComponentTransform() : GetOwner()->GetActorTransform();
+
 	GetOwner()->SetActorTransform(ServerState.Transform);
 
 	MovementComp->SetVelocity(ServerState.Velocity);
 
-	ClearAcknowledgedMoves(ServerState.LastMove);
+	ReplayUnacknowledgedMoves();
+
+	MovementComp->ResetStepInterpolation();
+
+	++CorrectionCount;
+	GOKART_INC_COUNTER(Corrections, 1);
+	LastCorrectionSize = FVector::Dist(PredictedLocation, GetOwner()->GetActorLocation());
 
-	for (const FGoKartMove& Move : UnacknowledgedMoves) MovementComp->SimulateMove(Move);
+	++ErrorStats.Corrections;
+	ErrorStats.TotalCorrectionSize += LastCorrectionSize;
+	ErrorStats.MaxCorrectionSize = FMath::Max(ErrorStats.MaxCorrectionSize, LastCorrectionSize);
+
+	// Keep the mesh where the player saw it and ease it onto the corrected kart
+	CorrectionLocationOffset = MeshTransform.GetLocation() - GetOwner()->GetActorLocation();
+	CorrectionRotationOffset = MeshTransform.GetRotation() * GetOwner()->GetActorQuat().Inverse();
+	bSmoothingCorrection = true;
 }
 
-void UGoKartMovementReplicator::ClientTick(float DeltaTime)
+bool UGoKartMovementReplicator::IsPredictionCorrect() const
 {
-	ClientTimeSinceUpdate += DeltaTime;
+	const FGoKartPredictedState& Predicted = PredictedStates[ServerState.LastMove.Sequence & (FGoKartMoveHistory::Capacity - 1)];
+	if (Predicted.Sequence != ServerState.LastMove.Sequence) return false;
 
-	if (ClientTimeBetweenLastUpdates < KINDA_SMALL_NUMBER) return;
-	if (MovementComp == nullptr) return;
+	if (!Predicted.Location.Equals(ServerState.Transform.GetLocation(), ReconcileLocationTolerance)) return false;
+	if (!Predicted.Velocity.Equals(ServerState.Velocity, ReconcileVelocityTolerance)) return false;
 
-	FHermiteCubicSpline Spline = CreateSpline();
+	float RotationError = FMath::RadiansToDegrees(Predicted.Rotation.AngularDistance(ServerState.Transform.GetRotation()));
+	return RotationError <= ReconcileRotationTolerance;
+}
 
-	float LerpRatio = ClientTimeSinceUpdate / ClientTimeBetweenLastUpdates;
-	InterpolateLocation(Spline, LerpRatio);
-	InterpolateVelocity(Spline, LerpRatio);
-	InterpolateRotation(LerpRatio);
+void UGoKartMovementReplicator::ReplayUnacknowledgedMoves()
+{
+	if (UnacknowledgedMoves.IsEmpty()) return;
+
+	GOKART_INC_COUNTER(MovesReplayed, UnacknowledgedMoves.Num());
+
+	// The pre-correction predictions are stale, so each replayed move's result replaces its prediction.
+	// Otherwise the next acks would be compared against them and trigger correction after correction.
+
+	// The track grid is cheap enough to collide every replayed move, like the original prediction did
+	if (MovementComp->IsTrackCollisionAvailable())
+	{
+		for (int32 Index = 0; Index < UnacknowledgedMoves.Num(); ++Index)
+		{
+			MovementComp->SimulateMove(UnacknowledgedMoves[Index]);
+			UpdatePredictedState(UnacknowledgedMoves[Index].Sequence);
+		}
+		return;
+	}
+
+	FVector StartLocation = GetOwner()->GetActorLocation();
+
+	for (int32 Index = 0; Index < UnacknowledgedMoves.Num(); ++Index)
+	{
+		MovementComp->SimulateMove(UnacknowledgedMoves[Index], false);
+		UpdatePredictedState(UnacknowledgedMoves[Index].Sequence);
+	}
+
+	FVector EndLocation = GetOwner()->GetActorLocation();
+
+	FHitResult Hit;
+	GOKART_INC_COUNTER(Sweeps, 1);
+	GetOwner()->SetActorLocation(StartLocation);
+	GetOwner()->SetActorLocation(EndLocation, true, &Hit);
+	if (Hit.IsValidBlockingHit()) MovementComp->SetVelocity(FVector::ZeroVector);
+
+	// The newest move ends where the sweep did
+	UpdatePredictedState(UnacknowledgedMoves[UnacknowledgedMoves.Num() - 1].Sequence);
+}
+
+void UGoKartMovementReplicator::UpdatePredictedState(uint32 Sequence)
+{
+	FGoKartPredictedState& State = PredictedStates[Sequence & (FGoKartMoveHistory::Capacity - 1)];
+	State.Sequence = Sequence;
+	State.Location = GetOwner()->GetActorLocation();
+	State.Rotation = GetOwner()->GetActorQuat();
+	State.Velocity = MovementComp->GetVelocity();
 }
 
-FHermiteCubicSpline UGoKartMovementReplicator::CreateSpline()
+void UGoKartMovementReplicator::SnapshotClientTick(float DeltaTime, FGoKartProxySmoothingBatch* ProxyBatch)
 {
-	FHermiteCubicSpline Spline;
+	if (ClientSnapshots.Num() == 0) return;
+
+	float Delay = FMath::Max(InterpolationDelay, 1.5f * ClientSnapshotInterval);
+	float TargetRenderTime = ClientSnapshots.Newest().Time - Delay;
+
+	// Advance at wall clock rate and steer gently toward the target, so arrival jitter does not show
+	ClientRenderTime += DeltaTime;
+	float Drift = TargetRenderTime - ClientRenderTime;
+	if (FMath::Abs(Drift) > Delay) ClientRenderTime = TargetRenderTime;
+	else ClientRenderTime += Drift * FMath::Min(1.0f, DeltaTime);
 
-	Spline.TargetLocation = ServerState.Transform.GetLocation();
-	Spline.StartLocation = ClientStartTransform.GetLocation();
-	Spline.StartDerivative = ClientStartVelocity * VelocityToDerivative();
-	Spline.TargetDerivative = ServerState.Velocity * VelocityToDerivative();
+	if (MovementComp == nullptr) return;
+
+	// Between two snapshots, hand the batch the same Hermite segment that Sample would evaluate
+	int32 Segment = ProxyBatch != nullptr ? ClientSnapshots.FindSegment(ClientRenderTime) : INDEX_NONE;
+	if (Segment != INDEX_NONE)
+	{
+		const FGoKartSnapshot& Start = ClientSnapshots[Segment];
+		const FGoKartSnapshot& Target = ClientSnapshots[Segment + 1];
+
+		float SegmentTime = Target.Time - Start.Time;
+		float DerivativeScale = SegmentTime * 100;
+		FHermiteCubicSpline Spline(Start.Location, Start.Velocity * DerivativeScale, Target.Location, Target.Velocity * DerivativeScale);
+
+		ProxyBatch->Add(this, Spline, (ClientRenderTime - Start.Time) / SegmentTime, 1.0f / DerivativeScale, Start.Rotation, Target.Rotation);
+		return;
+	}
+
+	FGoKartSnapshot Sample;
+	if (!ClientSnapshots.Sample(ClientRenderTime, MaxExtrapolationTime, Sample)) return;
+
+	if (MeshOffsetRoot != nullptr) MeshOffsetRoot->SetWorldLocationAndRotation(Sample.Location, Sample.Rotation);
 
-	return Spline;
+	MovementComp->SetVelocity(Sample.Velocity);
 }
 
-void UGoKartMovementReplicator::InterpolateLocation(const FHermiteCubicSpline& Spline, float LerpRatio)
+void UGoKartMovementReplicator::ClientTick(float DeltaTime, FGoKartProxySmoothingBatch* ProxyBatch)
 {
-	if (MeshOffsetRoot != nullptr)
+	GOKART_SCOPE_CYCLE_COUNTER(ClientTick);
+
+	if (bUseSnapshotInterpolation)
+	{
+		SnapshotClientTick(DeltaTime, ProxyBatch);
+		return;
+	}
+
+	ClientTimeSinceUpdate += DeltaTime;
+
+	if (ClientTimeBetweenLastUpdates < KINDA_SMALL_NUMBER) return;
+	if (MovementComp == nullptr) return;
+
+	float LerpRatio = ClientTimeSinceUpdate / ClientTimeBetweenLastUpdates;
+	FQuat TargetRotation = ServerState.Transform.GetRotation();
+
+	if (ProxyBatch != nullptr)
 	{
-		MeshOffsetRoot->SetWorldLocation(Spline.InterpolateLocation(LerpRatio));
+		ProxyBatch->Add(this, ClientSpline, LerpRatio, ClientInvDerivativeScale, ClientStartTransform.GetRotation(), TargetRotation);
+		return;
 	}
+
+	FQuat Rotation = FQuat::FastLerp(ClientStartTransform.GetRotation(), TargetRotation, LerpRatio).GetNormalized();
+	ApplyProxySmoothing(ClientSpline.InterpolateLocation(LerpRatio), Rotation, ClientSpline.InterpolateDerivative(LerpRatio) * ClientInvDerivativeScale);
 }
 
-void UGoKartMovementReplicator::InterpolateVelocity(const FHermiteCubicSpline& Spline, float LerpRatio)
+void UGoKartMovementReplicator::ApplyProxySmoothing(const FVector& Location, const FQuat& Rotation, const FVector& Velocity)
 {
-	FVector NewDerivative = Spline.InterpolateDerivative(LerpRatio);
+	if (MeshOffsetRoot != nullptr) MeshOffsetRoot->SetWorldLocationAndRotation(Location, Rotation);
 
-	MovementComp->SetVelocity(NewDerivative / VelocityToDerivative());
+	MovementComp->SetVelocity(Velocity);
 }
 
-void UGoKartMovementReplicator::InterpolateRotation(float LerpRatio)
+void UGoKartMovementReplicator::UpdateLocalMesh(float DeltaTime, bool bLocallyStepped)
 {
-	if (MeshOffsetRoot != nullptr)
+	if (MeshOffsetRoot == nullptr) return;
+
+	bool bBlendFixedStep = bLocallyStepped && MovementComp->IsUsingFixedTimestep();
+	if (!bBlendFixedStep && !bSmoothingCorrection) return;
+
+	FTransform TargetTransform = GetOwner()->GetActorTransform();
+	FVector Location = TargetTransform.GetLocation();
+	FQuat Rotation = TargetTransform.GetRotation();
+
+	if (bBlendFixedStep)
 	{
-		FQuat TargetRotation = ServerState.Transform.GetRotation();
-		FQuat StartRotation = ClientStartTransform.GetRotation();
+		const FTransform& StartTransform = MovementComp->GetPreviousStepTransform();
+		float Alpha = FMath::Clamp(MovementComp->GetFixedStepAlpha(), 0.0f, 1.0f);
+
+		Location = FMath::Lerp(StartTransform.GetLocation(), Location, Alpha);
+		Rotation = FQuat::Slerp(StartTransform.GetRotation(), Rotation, Alpha);
+	}
 
-		MeshOffsetRoot->SetWorldRotation(FQuat::Slerp(StartRotation, TargetRotation, LerpRatio));
+	if (bSmoothingCorrection)
+	{
+		float Alpha = FMath::Min(1.0f, DeltaTime / CorrectionSmoothTime);
+		CorrectionLocationOffset = FMath::Lerp(CorrectionLocationOffset, FVector::ZeroVector, Alpha);
+		CorrectionRotationOffset = FQuat::Slerp(CorrectionRotationOffset, FQuat::Identity, Alpha);
+
+		// Snap the last bit so the mesh ends exactly on the kart
+		if (CorrectionLocationOffset.IsNearlyZero(0.1f) && CorrectionRotationOffset.Equals(FQuat::Identity, KINDA_SMALL_NUMBER))
+		{
+			CorrectionLocationOffset = FVector::ZeroVector;
+			CorrectionRotationOffset = FQuat::Identity;
+			bSmoothingCorrection = false;
+		}
+
+		Location += CorrectionLocationOffset;
+		Rotation = CorrectionRotationOffset * Rotation;
 	}
+
+	MeshOffsetRoot->SetWorldLocationAndRotation(Location, Rotation);
 }
 
 void UGoKartMovementReplicator::UpdateServerState(const FGoKartMove& Move)
 {
 	ServerState.LastMove = Move;
+	ServerState.ServerTime = GetWorld()->TimeSeconds;
 	ServerState.Transform = GetOwner()->GetActorTransform();
 	ServerState.Velocity = MovementComp->GetVelocity();
+
+	FGoKartSnapshot Snapshot;
+	Snapshot.Time = ServerState.ServerTime;
+	Snapshot.Location = ServerState.Transform.GetLocation();
+	Snapshot.Rotation = ServerState.Transform.GetRotation();
+	Snapshot.Velocity = ServerState.Velocity;
+	ServerStateHistory.Add(Snapshot);
+
+	if (FGoKartRecorder::IsRecording()) FGoKartRecorder::RecordState(MovementComp);
 }
 
-void UGoKartMovementReplicator::ClearAcknowledgedMoves(FGoKartMove LastMove)
+float UGoKartMovementReplicator::GetContactRewindTime() const
 {
-	TArray<FGoKartMove> NewMoves;
+	if (!FGoKartLagCompensation::IsEnabled() || GetOwner()->GetRemoteRole() != ROLE_AutonomousProxy) return 0.0f;
+
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	if (Pawn == nullptr || Pawn->PlayerState == nullptr) return 0.0f;
 
-	for (const FGoKartMove& Move : UnacknowledgedMoves)
+	// Other karts reach the client half a round trip late, and are drawn InterpolationDelay behind that
+	float RewindTime = Pawn->PlayerState->ExactPing * 0.001f * 0.5f;
+	if (bUseSnapshotInterpolation) RewindTime += InterpolationDelay;
+
+	return FMath::Min(RewindTime, MaxContactRewindTime);
+}
+
+void UGoKartMovementReplicator::ClearAcknowledgedMoves(const FGoKartMove& LastMove)
+{
+	GOKART_SCOPE_CYCLE_COUNTER(ClearAcknowledgedMoves);
+
+	UnacknowledgedMoves.AcknowledgeThrough(LastMove.Sequence);
+	UploadedMoves.AcknowledgeThrough(LastMove.Sequence);
+
+	bUnacknowledgedMovesOverflowed = false;
+}
+
+void UGoKartMovementReplicator::SendMoveBatch()
+{
+	// Signed distance so sequence wrap-around still compares correctly
+	int32 FirstUnsent = UnacknowledgedMoves.Num();
+	while (FirstUnsent > 0 && (int32)(UnacknowledgedMoves[FirstUnsent - 1].Sequence - ClientLastSentSequence) > 0) --FirstUnsent;
+
+	// A fast client makes more moves per packet than fit, so spread them evenly over the slots and merge each
+	// slot's moves into one. Merged uploads keep the newest move's sequence, so acknowledgement is unchanged.
+	int32 NumUnsent = UnacknowledgedMoves.Num() - FirstUnsent;
+	int32 NumSlots = FMath::Min(NumUnsent, MaxMovesPerPacket);
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
 	{
-		if (Move.Time > LastMove.Time) NewMoves.Add(Move);
+		int32 First = FirstUnsent + NumUnsent * Slot / NumSlots;
+		int32 Last = FirstUnsent + NumUnsent * (Slot + 1) / NumSlots - 1;
+
+		FGoKartMove Merged = UnacknowledgedMoves[Last];
+		float Throttle = Merged.Throttle * Merged.DeltaTime;
+		float SteeringThrow = Merged.SteeringThrow * Merged.DeltaTime;
+		for (int32 Index = First; Index < Last; ++Index)
+		{
+			const FGoKartMove& Move = UnacknowledgedMoves[Index];
+			Throttle += Move.Throttle * Move.DeltaTime;
+			SteeringThrow += Move.SteeringThrow * Move.DeltaTime;
+			Merged.DeltaTime += Move.DeltaTime;
+		}
+
+		// Time weighted input, the closest one move gets to the moves it replaces
+		if (Merged.DeltaTime > KINDA_SMALL_NUMBER)
+		{
+			Merged.Throttle = FMath::Clamp(Throttle / Merged.DeltaTime, -1.0f, 1.0f);
+			Merged.SteeringThrow = FMath::Clamp(SteeringThrow / Merged.DeltaTime, -1.0f, 1.0f);
+		}
+
+		UploadedMoves.Add(Merged);
 	}
 
-	UnacknowledgedMoves = NewMoves;
+	if (NumUnsent > 0) ClientLastSentSequence = UnacknowledgedMoves[UnacknowledgedMoves.Num() - 1].Sequence;
+
+	if (UploadedMoves.IsEmpty()) return;
+
+	// The new uploads are the newest, so they always fit. Leftover slots resend older ones in case they were lost.
+	MoveBatch.Reset();
+
+	int32 First = FMath::Max(0, UploadedMoves.Num() - MaxMovesPerPacket);
+	for (int32 Index = First; Index < UploadedMoves.Num(); ++Index) MoveBatch.Add(UploadedMoves[Index]);
+
+	Server_SendMoves(MoveBatch);
 }
 
-void UGoKartMovementReplicator::Server_SendMove_Implementation(FGoKartMove Move)
+void UGoKartMovementReplicator::ReceiveMove(const FGoKartMove& Move)
 {
 	if (MovementComp == nullptr) return;
+	if (!IsNewMove(Move)) return;
+
+	ServerLastMoveSequence = Move.Sequence;
+	++ServerMovesReceived;
+
+	FGoKartMove Spent = Move;
+	if (!SpendMoveTime(Spent))
+	{
+		++ServerMovesDropped;
+		return;
+	}
+
+	// Hold the move, merging it into one already held, until it is long enough and a token is free
+	if (bServerHasMergedMove)
+	{
+		ServerMergedMove.Throttle = Spent.Throttle;
+		ServerMergedMove.SteeringThrow = Spent.SteeringThrow;
+		ServerMergedMove.DeltaTime += Spent.DeltaTime;
+		ServerMergedMove.Time = Spent.Time;
+		ServerMergedMove.Sequence = Spent.Sequence;
+		++ServerMovesMerged;
+	}
+	else
+	{
+		ServerMergedMove = Spent;
+		bServerHasMergedMove = true;
+	}
+
+	ReleaseMergedMove();
+}
+
+void UGoKartMovementReplicator::TickMoveLimits(float DeltaTime)
+{
+	ServerMoveTimeBank = FMath::Min(ServerMoveTimeBank + DeltaTime, MaxMoveTimeBank);
+	ServerMoveTokens = FMath::Min(ServerMoveTokens + DeltaTime * MaxMovesPerSecond, MaxMoveBurst);
+
+	ReleaseMergedMove();
+}
+
+bool UGoKartMovementReplicator::SpendMoveTime(FGoKartMove& Move)
+{
+	// Less than this left is not worth a move
+	const float MinSpendableTime = 0.001f;
+
+	if (ServerMoveTimeBank < MinSpendableTime) return false;
 
-	ClientSimulatedTime += Move.DeltaTime;
+	if (Move.DeltaTime > ServerMoveTimeBank)
+	{
+		Move.DeltaTime = ServerMoveTimeBank;
+		++ServerMovesClamped;
+	}
+
+	ServerMoveTimeBank -= Move.DeltaTime;
+	return true;
+}
+
+void UGoKartMovementReplicator::ReleaseMergedMove()
+{
+	if (!bServerHasMergedMove) return;
+	if (ServerMergedMove.DeltaTime < MinMoveDeltaTime || ServerMoveTokens < 1.0f) return;
+
+	ServerMoveTokens -= 1.0f;
+	bServerHasMergedMove = false;
+
+	AcceptMove(ServerMergedMove);
+}
+
+void UGoKartMovementReplicator::AcceptMove(const FGoKartMove& Move)
+{
+	if (!bQueueServerMoves)
+	{
+		SimulateClientMove(Move);
+		return;
+	}
+
+	UpdateArrivalJitter(Move);
+
+	// A full queue drops its oldest move to make room, so that move's time is no longer queued
+	float EvictedTime = ServerMoveQueue.Num() == FGoKartMoveHistory::Capacity ? ServerMoveQueue[0].DeltaTime : 0.0f;
+
+	if (!ServerMoveQueue.Add(Move)) UE_LOG(LogTemp, Warning, TEXT("Server move queue is full, dropping oldest move."));
+
+	ServerQueuedTime = FMath::Max(0.0f, ServerQueuedTime - EvictedTime) + Move.DeltaTime;
+}
+
+void UGoKartMovementReplicator::SimulateClientMove(const FGoKartMove& Move)
+{
+	if (FGoKartRecorder::IsRecording()) FGoKartRecorder::RecordMove(MovementComp, Move);
+
+	if (bExternalServerSimulation)
+	{
+		ServerPendingMoves.Add(Move);
+		return;
+	}
 
 	MovementComp->SimulateMove(Move);
 
 	UpdateServerState(Move);
 }
 
+void UGoKartMovementReplicator::SetExternalServerSimulation(bool bExternal)
+{
+	if (bExternal == bExternalServerSimulation) return;
+
+	bExternalServerSimulation = bExternal;
+
+	// Simulate whatever arrived since the last TakeServerMoves ourselves
+	if (!bExternalServerSimulation)
+	{
+		// Already recorded when they were queued
+		for (const FGoKartMove& Move : ServerPendingMoves) MovementComp->SimulateMove(Move);
+		if (ServerPendingMoves.Num() > 0) UpdateServerState(ServerPendingMoves.Last());
+		ServerPendingMoves.Reset();
+	}
+}
+
+void UGoKartMovementReplicator::TakeServerMoves(float DeltaTime, TArray<FGoKartMove>& OutMoves)
+{
+	check(bExternalServerSimulation);
+
+	if (bQueueServerMoves) TickServerMoveQueue(DeltaTime);
+
+	// Swap so both arrays keep their allocations from frame to frame
+	OutMoves.Reset();
+	Swap(OutMoves, ServerPendingMoves);
+}
+
+void UGoKartMovementReplicator::ApplyServerMoves(const FGoKartMove& LastMove, const FVector& Location, const FQuat& Rotation, const FVector& Velocity)
+{
+	GetOwner()->SetActorLocationAndRotation(Location, Rotation);
+	MovementComp->SetVelocity(Velocity);
+
+	UpdateServerState(LastMove);
+}
+
+void UGoKartMovementReplicator::UpdateArrivalJitter(const FGoKartMove& Move)
+{
+	// Transit time includes the unknown clock offset, but its change between moves does not
+	float TransitTime = GetWorld()->TimeSeconds - Move.Time;
+	float Variation = FMath::Abs(TransitTime - ServerLastTransitTime);
+
+	ServerLastTransitTime = TransitTime;
+	ServerArrivalJitter += (Variation - ServerArrivalJitter) / 16.0f;
+}
+
+void UGoKartMovementReplicator::TickServerMoveQueue(float DeltaTime)
+{
+	const float StepTime = 1.0f / ServerSimRate;
+	// Same hitch guard as the client fixed step
+	const int32 MaxStepsPerFrame = 4;
+	int32 Steps = 0;
+
+	ServerStepAccumulator += DeltaTime;
+
+	while (ServerStepAccumulator >= StepTime && Steps < MaxStepsPerFrame)
+	{
+		ServerStepAccumulator -= StepTime;
+		++Steps;
+
+		DrainServerMoveQueue(StepTime);
+	}
+
+	if (Steps == MaxStepsPerFrame) ServerStepAccumulator = FMath::Min(ServerStepAccumulator, StepTime);
+}
+
+void UGoKartMovementReplicator::DrainServerMoveQueue(float StepTime)
+{
+	GOKART_SCOPE_CYCLE_COUNTER(ServerDrainMoves);
+
+	if (ServerMoveQueue.IsEmpty())
+	{
+		// Ran dry, so refill the jitter buffer before consuming again
+		bServerQueuePrimed = false;
+		ServerMoveBudget = 0;
+		return;
+	}
+
+	float JitterBufferTime = GetJitterBufferTime();
+
+	if (!bServerQueuePrimed)
+	{
+		if (ServerQueuedTime < JitterBufferTime) return;
+		bServerQueuePrimed = true;
+	}
+
+	ServerMoveBudget += StepTime;
+	// Consume at double speed while the client is further ahead than the buffer needs
+	if (ServerQueuedTime > 2 * JitterBufferTime + StepTime) ServerMoveBudget += StepTime;
+
+	int32 MovesSimulated = 0;
+	while (!ServerMoveQueue.IsEmpty() && MovesSimulated < MaxMovesPerServerStep && ServerMoveQueue[0].DeltaTime <= ServerMoveBudget)
+	{
+		FGoKartMove Move = ServerMoveQueue.PopOldest();
+		ServerMoveBudget -= Move.DeltaTime;
+		ServerQueuedTime -= Move.DeltaTime;
+		++MovesSimulated;
+
+		SimulateClientMove(Move);
+	}
+
+	// Don't let budget pile up while the move budget holds the queue back, but let it grow enough for one long client frame
+	float NextMoveTime = ServerMoveQueue.IsEmpty() ? 0.0f : ServerMoveQueue[0].DeltaTime;
+	ServerMoveBudget = FMath::Min(ServerMoveBudget, FMath::Max(4 * StepTime, NextMoveTime));
+}
+
+void UGoKartMovementReplicator::Server_SendMove_Implementation(FGoKartMove Move)
+{
+	GOKART_SCOPE_CYCLE_COUNTER(ServerReceiveMoves);
+
+	++ServerPacketsReceived;
+
+	ReceiveMove(Move);
+}
+
 bool UGoKartMovementReplicator::Server_SendMove_Validate(FGoKartMove Move)
 {
-	float ProposedTime = ClientSimulatedTime + Move.DeltaTime;
-	bool ClientNotRunningAhead = ProposedTime < GetWorld()->TimeSeconds;
+	if (!IsNewMove(Move)) return true;
+
+	return IsMoveAcceptable(Move);
+}
+
+void UGoKartMovementReplicator::Server_SendMoves_Implementation(const TArray<FGoKartMove>& Moves)
+{
+	GOKART_SCOPE_CYCLE_COUNTER(ServerReceiveMoves);
+
+	++ServerPacketsReceived;
+
+	// Moves arrive oldest first, and the redundant ones were already simulated
+	for (const FGoKartMove& Move : Moves) ReceiveMove(Move);
+}
+
+void UGoKartMovementReplicator::ReceiveLoopbackMoves(const TArray<FGoKartMove>& Moves)
+{
+	check(GetOwnerRole() == ROLE_Authority);
+
+	if (!Server_SendMoves_Validate(Moves))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Rejected loopback moves."));
+		return;
+	}
+	Server_SendMoves_Implementation(Moves);
+}
 
-	if (!ClientNotRunningAhead)
+bool UGoKartMovementReplicator::Server_SendMoves_Validate(const TArray<FGoKartMove>& Moves)
+{
+	// Clients never send more, so a bigger packet is an attempt to make the server validate and queue unbounded moves
+	if (Moves.Num() > MaxMovesPerPacket)
 	{
-		UE_LOG(LogTemp, Error, TEXT("Client is running too fast."));
+		UE_LOG(LogTemp, Error, TEXT("Received %d moves in one packet, more than the %d allowed."), Moves.Num(), MaxMovesPerPacket);
 		return false;
 	}
+
+	for (const FGoKartMove& Move : Moves)
+	{
+		if (IsNewMove(Move) && !IsMoveAcceptable(Move)) return false;
+	}
+	return true;
+}
+
+// Only malformed moves fail validation and disconnect the client. Timing and rate abuse is absorbed by the time bank and merging.
+bool UGoKartMovementReplicator::IsMoveAcceptable(const FGoKartMove& Move) const
+{
 	if (!Move.IsValidMove())
 	{
 		UE_LOG(LogTemp, Error, TEXT("Recieved invalid move."));
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartNetQuantize.h"
+
+#include "HAL/IConsoleManager.h"
+
+// Read only so it can only be set from ini or the command line, and server and clients agree
+static TAutoConsoleVariable<float> CVarPositionResolution(
+	TEXT("kart.Net.PositionResolution"),
+	1.0f,
+	TEXT("Grid size (cm) replicated kart positions are snapped to. Must match on server and clients."),
+	ECVF_ReadOnly);
+
+static TAutoConsoleVariable<float> CVarVelocityResolution(
+	TEXT("kart.Net.VelocityResolution"),
+	0.01f,
+	TEXT("Grid size (m/s) replicated kart velocities are snapped to. Must match on server and clients."),
+	ECVF_ReadOnly);
+
+namespace
+{
+	// Karts only turn about their up axis, so tilt is float drift or a tilted spawn. Tilt that moves a point
+	// this far from the kart's centre by less than half a position grid cell is dropped, as it is below what the
+	// position quantization resolves anyway: about 0.29 degrees at the default 1cm grid.
+	const float YawOnlyLeverArm = 100.0f;
+
+	const int32 SmallestThreeBits = 15;
+	const uint32 SmallestThreeMax = (1 << SmallestThreeBits) - 1;
+
+	// Maps [-1/sqrt(2), 1/sqrt(2)] onto [-0.5, 0.5]
+	const float SmallestThreeScale = 0.70710678f;
+}
+
+float FGoKartNetQuantize::GetPositionResolution()
+{
+	return FMath::Max(CVarPositionResolution.GetValueOnAnyThread(), KINDA_SMALL_NUMBER);
+}
+
+float FGoKartNetQuantize::GetVelocityResolution()
+{
+	return FMath::Max(CVarVelocityResolution.GetValueOnAnyThread(), KINDA_SMALL_NUMBER);
+}
+
+void FGoKartNetQuantize::SerializeSignedPacked(FArchive& Ar, int32& Value)
+{
+	// ZigZag so small negative numbers stay small
+	uint32 Encoded = ((uint32)Value << 1) ^ (uint32)(Value >> 31);
+	Ar.SerializeIntPacked(Encoded);
+
+	if (Ar.IsLoading()) Value = (int32)(Encoded >> 1) ^ -(int32)(Encoded & 1);
+}
+
+void FGoKartNetQuantize::SerializeVector(FArchive& Ar, FVector& Value, float Resolution)
+{
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		int32 Quantized = FMath::RoundToInt(FMath::Clamp(Value[Axis] / Resolution, (float)-MAX_int32 / 2, (float)MAX_int32 / 2));
+		SerializeSignedPacked(Ar, Quantized);
+
+		if (Ar.IsLoading()) Value[Axis] = Quantized * Resolution;
+	}
+}
+
+void FGoKartNetQuantize::SerializeRotation(FArchive& Ar, FQuat& Value)
+{
+	uint8 bYawOnly = Ar.IsSaving() && Value.GetUpVector().Z >= FMath::Cos(0.5f * GetPositionResolution() / YawOnlyLeverArm);
+	Ar.SerializeBits(&bYawOnly, 1);
+
+	if (bYawOnly)
+	{
+		uint16 Yaw = FRotator::CompressAxisToShort(Value.Rotator().Yaw);
+		Ar << Yaw;
+
+		if (Ar.IsLoading()) Value = FRotator(0.0f, FRotator::DecompressAxisFromShort(Yaw), 0.0f).Quaternion();
+		return;
+	}
+
+	// Smallest three: drop the largest component and rebuild it from the unit length
+	float Components[4] = { Value.X, Value.Y, Value.Z, Value.W };
+	uint32 Largest = 0;
+	if (Ar.IsSaving())
+	{
+		for (uint32 Index = 1; Index < 4; ++Index)
+		{
+			if (FMath::Abs(Components[Index]) > FMath::Abs(Components[Largest])) Largest = Index;
+		}
+		// q and -q are the same rotation, so make the dropped component positive
+		if (Components[Largest] < 0.0f)
+		{
+			for (float& Component : Components) Component = -Component;
+		}
+	}
+	Ar.SerializeInt(Largest, 4);
+
+	float SumSquares = 0.0f;
+	for (uint32 Index = 0; Index < 4; ++Index)
+	{
+		if (Index == Largest) continue;
+
+		// The remaining components lie in [-1/sqrt(2), 1/sqrt(2)]
+		uint32 Quantized = FMath::Clamp(FMath::RoundToInt((Components[Index] * SmallestThreeScale + 0.5f) * SmallestThreeMax), 0, (int32)SmallestThreeMax);
+		Ar.SerializeInt(Quantized, SmallestThreeMax + 1);
+
+		Components[Index] = ((float)Quantized / SmallestThreeMax - 0.5f) / SmallestThreeScale;
+		SumSquares += FMath::Square(Components[Index]);
+	}
+
+	if (Ar.IsLoading())
+	{
+		Components[Largest] = FMath::Sqrt(FMath::Max(0.0f, 1.0f - SumSquares));
+		Value = FQuat(Components[0], Components[1], Components[2], Components[3]);
+		Value.Normalize();
+	}
+}
+
+void FGoKartNetQuantize::SerializeUnitFloat(FArchive& Ar, float& Value)
+{
+	int8 Quantized = (int8)FMath::RoundToInt(FMath::Clamp(Value, -1.0f, 1.0f) * 127.0f);
+	Ar << Quantized;
+
+	if (Ar.IsLoading()) Value = Quantized / 127.0f;
+}
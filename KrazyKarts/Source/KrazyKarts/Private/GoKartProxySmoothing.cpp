@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartProxySmoothing.h"
+
+#include "Math/VectorRegister.h"
+#include "GoKartMovementReplicator.h"
+
+void FGoKartProxySmoothingBatch::Reset()
+{
+	for (TArray<float>& Stream : Streams) Stream.Reset();
+
+	Replicators.Reset();
+	StartRotations.Reset();
+	TargetRotations.Reset();
+	Rotations.Reset();
+}
+
+void FGoKartProxySmoothingBatch::Add(UGoKartMovementReplicator* Replicator, const FHermiteCubicSpline& Spline, float InLerpRatio, float InInvDerivativeScale, const FQuat& StartRotation, const FQuat& TargetRotation)
+{
+	Streams[AX].Add(Spline.A.X);
+	Streams[AY].Add(Spline.A.Y);
+	Streams[AZ].Add(Spline.A.Z);
+	Streams[BX].Add(Spline.B.X);
+	Streams[BY].Add(Spline.B.Y);
+	Streams[BZ].Add(Spline.B.Z);
+	Streams[CX].Add(Spline.C.X);
+	Streams[CY].Add(Spline.C.Y);
+	Streams[CZ].Add(Spline.C.Z);
+	Streams[DX].Add(Spline.D.X);
+	Streams[DY].Add(Spline.D.Y);
+	Streams[DZ].Add(Spline.D.Z);
+	Streams[LerpRatio].Add(InLerpRatio);
+	Streams[InvDerivativeScale].Add(InInvDerivativeScale);
+
+	Replicators.Add(Replicator);
+	StartRotations.Add(StartRotation);
+	TargetRotations.Add(TargetRotation);
+}
+
+void FGoKartProxySmoothingBatch::Evaluate()
+{
+	int32 NumKarts = Num();
+	if (NumKarts == 0) return;
+
+	// Pad every stream to whole lanes with idle karts
+	int32 PaddedNum = Align(NumKarts, LaneCount);
+	for (TArray<float>& Stream : Streams) Stream.SetNumZeroed(PaddedNum, false);
+
+	float* S[NumStreams];
+	for (int32 Stream = 0; Stream < NumStreams; ++Stream) S[Stream] = Streams[Stream].GetData();
+
+	const VectorRegister Two = VectorSetFloat1(2.0f);
+	const VectorRegister Three = VectorSetFloat1(3.0f);
+
+	for (int32 Index = 0; Index < PaddedNum; Index += LaneCount)
+	{
+		const VectorRegister T = VectorLoad(S[LerpRatio] + Index);
+		const VectorRegister InvScale = VectorLoad(S[InvDerivativeScale] + Index);
+
+		// Location ((A t + B) t + C) t + D, derivative (3 A t + 2 B) t + C
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			const VectorRegister A = VectorLoad(S[AX + Axis] + Index);
+			const VectorRegister B = VectorLoad(S[BX + Axis] + Index);
+			const VectorRegister C = VectorLoad(S[CX + Axis] + Index);
+			const VectorRegister D = VectorLoad(S[DX + Axis] + Index);
+
+			VectorRegister Location = VectorMultiplyAdd(VectorMultiplyAdd(VectorMultiplyAdd(A, T, B), T, C), T, D);
+			VectorRegister Derivative = VectorMultiplyAdd(VectorMultiplyAdd(VectorMultiply(Three, A), T, VectorMultiply(Two, B)), T, C);
+
+			VectorStore(Location, S[LocationX + Axis] + Index);
+			VectorStore(VectorMultiply(Derivative, InvScale), S[VelocityX + Axis] + Index);
+		}
+	}
+
+	// Rotations only turn a little between updates, where a normalized lerp is indistinguishable from a slerp
+	Rotations.SetNumUninitialized(NumKarts);
+	for (int32 Index = 0; Index < NumKarts; ++Index)
+	{
+		Rotations[Index] = FQuat::FastLerp(StartRotations[Index], TargetRotations[Index], S[LerpRatio][Index]).GetNormalized();
+	}
+}
+
+void FGoKartProxySmoothingBatch::Apply() const
+{
+	const float* S[NumStreams];
+	for (int32 Stream = 0; Stream < NumStreams; ++Stream) S[Stream] = Streams[Stream].GetData();
+
+	for (int32 Index = 0; Index < Num(); ++Index)
+	{
+		FVector Location(S[LocationX][Index], S[LocationY][Index], S[LocationZ][Index]);
+		FVector Velocity(S[VelocityX][Index], S[VelocityY][Index], S[VelocityZ][Index]);
+		Replicators[Index]->ApplyProxySmoothing(Location, Rotations[Index], Velocity);
+	}
+}
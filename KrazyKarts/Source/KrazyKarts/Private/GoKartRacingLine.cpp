@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartRacingLine.h"
+
+#include "Components/SplineComponent.h"
+
+AGoKartRacingLine::AGoKartRacingLine()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	Spline = CreateDefaultSubobject<USplineComponent>(TEXT("Spline"));
+	Spline->SetClosedLoop(true);
+	RootComponent = Spline;
+}
+
+void AGoKartRacingLine::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	Bake();
+}
+
+void AGoKartRacingLine::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Normally baked in the editor
+	if (IsBaked()) InvBakedSpacing = 1.0f / BakedSpacing;
+	else Bake();
+}
+
+void AGoKartRacingLine::Bake()
+{
+	Samples.Reset();
+
+	float SplineLength = Spline->GetSplineLength();
+	int32 NumSamples = FMath::FloorToInt(SplineLength / SampleSpacing);
+	if (NumSamples < 3) return;
+
+	float Spacing = SplineLength / NumSamples;
+	Samples.SetNum(NumSamples);
+
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		Samples[Index].Location = Spline->GetLocationAtDistanceAlongSpline(Index * Spacing, ESplineCoordinateSpace::World);
+	}
+
+	// Curvature from the turn between neighbouring samples, in the ground plane
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		FVector2D Previous(Samples[(Index + NumSamples - 1) % NumSamples].Location);
+		FVector2D Current(Samples[Index].Location);
+		FVector2D Next(Samples[(Index + 1) % NumSamples].Location);
+
+		FVector2D In = (Current - Previous).GetSafeNormal();
+		FVector2D Out = (Next - Current).GetSafeNormal();
+		float TurnAngle = FMath::Atan2(In ^ Out, In | Out);
+
+		// cm to m
+		Samples[Index].Curvature = TurnAngle / (Spacing / 100.0f);
+	}
+
+	// Corner speed from v^2 = a / k, then back through the loop twice so braking for a corner starts early enough
+	for (FGoKartRacingLineSample& Sample : Samples)
+	{
+		float AbsCurvature = FMath::Abs(Sample.Curvature);
+		Sample.TargetSpeed = AbsCurvature > KINDA_SMALL_NUMBER ? FMath::Min(MaxSpeed, FMath::Sqrt(MaxLateralAcceleration / AbsCurvature)) : MaxSpeed;
+	}
+
+	float BrakingSpeedSquared = 2.0f * MaxBrakingDeceleration * (Spacing / 100.0f);
+	for (int32 Step = 2 * NumSamples - 1; Step >= 0; --Step)
+	{
+		FGoKartRacingLineSample& Sample = Samples[Step % NumSamples];
+		float NextSpeed = Samples[(Step + 1) % NumSamples].TargetSpeed;
+		Sample.TargetSpeed = FMath::Min(Sample.TargetSpeed, FMath::Sqrt(FMath::Square(NextSpeed) + BrakingSpeedSquared));
+	}
+
+	BakedSpacing = Spacing;
+	InvBakedSpacing = 1.0f / Spacing;
+}
+
+float AGoKartRacingLine::WrapDistance(float Distance) const
+{
+	float Length = GetLength();
+	Distance = FMath::Fmod(Distance, Length);
+	return Distance < 0 ? Distance + Length : Distance;
+}
+
+const FGoKartRacingLineSample& AGoKartRacingLine::GetSample(float Distance) const
+{
+	int32 Index = FMath::FloorToInt(WrapDistance(Distance) * InvBakedSpacing);
+	return Samples[FMath::Min(Index, Samples.Num() - 1)];
+}
+
+FVector AGoKartRacingLine::GetLocation(float Distance) const
+{
+	float Position = WrapDistance(Distance) * InvBakedSpacing;
+	int32 Index = FMath::Min(FMath::FloorToInt(Position), Samples.Num() - 1);
+
+	return FMath::Lerp(Samples[Index].Location, Samples[(Index + 1) % Samples.Num()].Location, Position - Index);
+}
+
+float AGoKartRacingLine::FindDistance(const FVector& Location, float Hint, float SearchRange) const
+{
+	int32 NumSamples = Samples.Num();
+	int32 HintIndex = FMath::FloorToInt(WrapDistance(Hint) * InvBakedSpacing);
+	int32 Range = FMath::Min(FMath::CeilToInt(SearchRange * InvBakedSpacing), NumSamples / 2);
+
+	int32 BestIndex = HintIndex;
+	float BestDistanceSquared = MAX_flt;
+	for (int32 Offset = -Range; Offset <= Range; ++Offset)
+	{
+		int32 Index = (HintIndex + Offset + NumSamples) % NumSamples;
+		float DistanceSquared = FVector::DistSquared(Location, Samples[Index].Location);
+		if (DistanceSquared < BestDistanceSquared)
+		{
+			BestDistanceSquared = DistanceSquared;
+			BestIndex = Index;
+		}
+	}
+
+	// Lost, e.g. spun off or just spawned: fall back to the whole loop
+	if (BestDistanceSquared > FMath::Square(MaxLineDistance))
+	{
+		for (int32 Index = 0; Index < NumSamples; ++Index)
+		{
+			float DistanceSquared = FVector::DistSquared(Location, Samples[Index].Location);
+			if (DistanceSquared < BestDistanceSquared)
+			{
+				BestDistanceSquared = DistanceSquared;
+				BestIndex = Index;
+			}
+		}
+	}
+
+	return BestIndex * BakedSpacing;
+}
+
+FTransform AGoKartRacingLine::GetGridSlot(int32 Slot) const
+{
+	// Rows 6m apart, karts 1.5m either side of the line
+	const float RowSpacing = 600.0f;
+	const float LaneOffset = 150.0f;
+
+	float Distance = -(Slot / 2 + 1) * RowSpacing;
+	FVector Location = GetLocation(Distance);
+	FVector Forward = (GetLocation(Distance + BakedSpacing) - Location).GetSafeNormal2D();
+	FVector Right = FVector::CrossProduct(FVector::UpVector, Forward);
+
+	return FTransform(Forward.Rotation(), Location + Right * (Slot % 2 == 0 ? -LaneOffset : LaneOffset));
+}
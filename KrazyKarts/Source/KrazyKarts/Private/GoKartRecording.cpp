@@ -0,0 +1,405 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartRecording.h"
+
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+#include "Serialization/MemoryReader.h"
+#include "GoKart.h"
+#include "GoKartNetQuantize.h"
+
+static TAutoConsoleVariable<int32> CVarReplayCheckpointInterval(
+	TEXT("kart.Replay.CheckpointInterval"),
+	30,
+	TEXT("Moves between the kart state checkpoints a recording is checked against on playback."));
+
+static TAutoConsoleVariable<FString> CVarReplayKartClass(
+	TEXT("kart.Replay.KartClass"),
+	TEXT("/Game/KrazyKarts/Blueprints/BP_GoKart.BP_GoKart_C"),
+	TEXT("Class spawned for recorded karts on playback. Falls back to AGoKart when it can not be loaded."));
+
+static TAutoConsoleVariable<int32> CVarReplayExitWhenDone(
+	TEXT("kart.Replay.ExitWhenDone"),
+	0,
+	TEXT("Exit the process once playback has reported, for CI runs."));
+
+namespace
+{
+	// "GKRC"
+	const uint32 RecordingMagic = 0x43524B47;
+	const uint32 RecordingVersion = 1;
+
+	enum EEventTag : uint32
+	{
+		SpawnEvent,
+		MoveEvent,
+		CheckpointEvent,
+		NumEventTags = 4
+	};
+
+	// Throttle and steering from keys or a quantized pad are exact in one byte, anything else is kept as is
+	void SerializeInput(FArchive& Ar, float& Value)
+	{
+		float Quantized = FMath::RoundToInt(FMath::Clamp(Value, -1.0f, 1.0f) * 127.0f) / 127.0f;
+		uint8 bExact = Ar.IsSaving() && Quantized == Value;
+		Ar.SerializeBits(&bExact, 1);
+
+		if (bExact) FGoKartNetQuantize::SerializeUnitFloat(Ar, Value);
+		else Ar << Value;
+	}
+
+	// Time is only used for the server's jitter estimate, so it is not recorded
+	void SerializeMove(FArchive& Ar, FGoKartMove& Move, uint32& LastSequence, float& LastDeltaTime)
+	{
+		uint32 SequenceDelta = Move.Sequence - LastSequence;
+		Ar.SerializeIntPacked(SequenceDelta);
+
+		SerializeInput(Ar, Move.Throttle);
+		SerializeInput(Ar, Move.SteeringThrow);
+
+		uint8 bSameDeltaTime = Ar.IsSaving() && Move.DeltaTime == LastDeltaTime;
+		Ar.SerializeBits(&bSameDeltaTime, 1);
+		if (bSameDeltaTime) Move.DeltaTime = LastDeltaTime;
+		else Ar << Move.DeltaTime;
+
+		if (Ar.IsLoading())
+		{
+			Move.Sequence = LastSequence + SequenceDelta;
+			Move.Time = 0;
+		}
+
+		LastSequence = Move.Sequence;
+		LastDeltaTime = Move.DeltaTime;
+	}
+
+	// Full precision, playback has to start from exactly where the server was
+	void SerializeSpawn(FArchive& Ar, FGoKartDynamicsParams& Params, FVector& Location, FQuat& Rotation, FVector& Velocity)
+	{
+		Ar << Params.Mass << Params.MaxDrivingForce << Params.MinTurningRadius << Params.DragCoef << Params.RollingResistanceCoef << Params.GravityZ;
+		Ar << Location << Rotation << Velocity;
+
+		if (Ar.IsLoading()) Params.UpdateDerived();
+	}
+
+	void SerializeCheckpoint(FArchive& Ar, FVector& Location, FQuat& Rotation, FVector& Velocity, float PositionResolution, float VelocityResolution)
+	{
+		FGoKartNetQuantize::SerializeVector(Ar, Location, PositionResolution);
+		FGoKartNetQuantize::SerializeRotation(Ar, Rotation);
+		FGoKartNetQuantize::SerializeVector(Ar, Velocity, VelocityResolution);
+	}
+}
+
+FArchive* FGoKartRecorder::Writer = nullptr;
+TMap<TWeakObjectPtr<const UGoKartMovementComp>, FGoKartRecorder::FKart> FGoKartRecorder::Karts;
+uint32 FGoKartRecorder::NextKartId = 1;
+FBitWriter* FGoKartRecorder::FrameWriter = nullptr;
+uint32 FGoKartRecorder::FrameEvents = 0;
+FDelegateHandle FGoKartRecorder::EndFrameHandle;
+
+void FGoKartRecorder::StartRecording(const FString& Path)
+{
+	StopRecording();
+
+	Writer = IFileManager::Get().CreateFileWriter(*Path);
+	if (Writer == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not open %s for kart recording."), *Path);
+		return;
+	}
+
+	uint32 Magic = RecordingMagic;
+	uint32 Version = RecordingVersion;
+	float PositionResolution = FGoKartNetQuantize::GetPositionResolution();
+	float VelocityResolution = FGoKartNetQuantize::GetVelocityResolution();
+	*Writer << Magic << Version << PositionResolution << VelocityResolution;
+
+	FrameWriter = new FBitWriter(0, true);
+	FrameEvents = 0;
+	NextKartId = 1;
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&FGoKartRecorder::WriteFrame);
+
+	UE_LOG(LogTemp, Display, TEXT("Recording kart moves to %s"), *Path);
+}
+
+void FGoKartRecorder::StopRecording()
+{
+	if (Writer == nullptr) return;
+
+	WriteFrame();
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+
+	Writer->Close();
+	delete Writer;
+	Writer = nullptr;
+
+	delete FrameWriter;
+	FrameWriter = nullptr;
+
+	Karts.Reset();
+}
+
+void FGoKartRecorder::RecordMove(const UGoKartMovementComp* MovementComp, const FGoKartMove& Move)
+{
+	if (!IsRecording()) return;
+
+	FKart* Kart = Karts.Find(MovementComp);
+	if (Kart == nullptr)
+	{
+		Kart = &Karts.Add(MovementComp);
+		Kart->Id = NextKartId++;
+		Kart->LastSequence = 0;
+		Kart->LastDeltaTime = 0;
+		Kart->MovesSinceCheckpoint = 0;
+
+		FGoKartDynamicsParams Params = MovementComp->GetDynamicsParams();
+		FVector Location = MovementComp->GetOwner()->GetActorLocation();
+		FQuat Rotation = MovementComp->GetOwner()->GetActorQuat();
+		FVector Velocity = MovementComp->GetVelocity();
+
+		uint32 Tag = SpawnEvent;
+		FrameWriter->SerializeInt(Tag, NumEventTags);
+		FrameWriter->SerializeIntPacked(Kart->Id);
+		SerializeSpawn(*FrameWriter, Params, Location, Rotation, Velocity);
+		++FrameEvents;
+	}
+
+	FGoKartMove Recorded = Move;
+	uint32 Tag = MoveEvent;
+	FrameWriter->SerializeInt(Tag, NumEventTags);
+	FrameWriter->SerializeIntPacked(Kart->Id);
+	SerializeMove(*FrameWriter, Recorded, Kart->LastSequence, Kart->LastDeltaTime);
+	++FrameEvents;
+
+	++Kart->MovesSinceCheckpoint;
+}
+
+void FGoKartRecorder::RecordState(const UGoKartMovementComp* MovementComp)
+{
+	if (!IsRecording()) return;
+
+	FKart* Kart = Karts.Find(MovementComp);
+	if (Kart == nullptr || Kart->MovesSinceCheckpoint < CVarReplayCheckpointInterval.GetValueOnGameThread()) return;
+
+	Kart->MovesSinceCheckpoint = 0;
+
+	FVector Location = MovementComp->GetOwner()->GetActorLocation();
+	FQuat Rotation = MovementComp->GetOwner()->GetActorQuat();
+	FVector Velocity = MovementComp->GetVelocity();
+
+	uint32 Tag = CheckpointEvent;
+	FrameWriter->SerializeInt(Tag, NumEventTags);
+	FrameWriter->SerializeIntPacked(Kart->Id);
+	SerializeCheckpoint(*FrameWriter, Location, Rotation, Velocity, FGoKartNetQuantize::GetPositionResolution(), FGoKartNetQuantize::GetVelocityResolution());
+	++FrameEvents;
+}
+
+void FGoKartRecorder::RemoveKart(const UGoKartMovementComp* MovementComp)
+{
+	Karts.Remove(MovementComp);
+}
+
+void FGoKartRecorder::WriteFrame()
+{
+	if (FrameEvents == 0) return;
+
+	uint32 NumBits = FrameWriter->GetNumBits();
+	Writer->SerializeIntPacked(FrameEvents);
+	Writer->SerializeIntPacked(NumBits);
+	Writer->Serialize(FrameWriter->GetData(), FrameWriter->GetNumBytes());
+
+	FrameWriter->Reset();
+	FrameEvents = 0;
+}
+
+static void StartRecordingCommand(const TArray<FString>& Args)
+{
+	FString Path = Args.Num() > 0 ? Args[0] : FPaths::GameSavedDir() / TEXT("KartRecordings") / FString::Printf(TEXT("KartMoves-%s.gkrc"), *FDateTime::Now().ToString());
+	FGoKartRecorder::StartRecording(Path);
+}
+
+static FAutoConsoleCommand StartRecordingConsoleCommand(
+	TEXT("kart.Replay.StartRecording"),
+	TEXT("Records every client move the server simulates, for kart.Replay.Play. Args: [Path]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&StartRecordingCommand));
+
+static FAutoConsoleCommand StopRecordingConsoleCommand(
+	TEXT("kart.Replay.StopRecording"),
+	TEXT("Stops a kart move recording."),
+	FConsoleCommandDelegate::CreateStatic(&FGoKartRecorder::StopRecording));
+
+// Spawns a kart per recorded kart and feeds each its recorded moves in the order the server simulated them,
+// comparing against every checkpoint. Runs the whole recording within one frame, as fast as it can.
+static void PlayRecording(const TArray<FString>& Args, UWorld* World)
+{
+	if (World == nullptr || World->GetNetMode() == NM_Client || Args.Num() < 1)
+	{
+		UE_LOG(LogTemp, Error, TEXT("kart.Replay.Play needs a recording path and must run on a server or standalone world."));
+		return;
+	}
+
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Args[0]))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not read kart recording %s"), *Args[0]);
+		return;
+	}
+
+	FMemoryReader Reader(Data);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	float PositionResolution = 0;
+	float VelocityResolution = 0;
+	Reader << Magic << Version << PositionResolution << VelocityResolution;
+	if (Magic != RecordingMagic || Version != RecordingVersion)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s is not a version %u kart recording."), *Args[0], RecordingVersion);
+		return;
+	}
+
+	UClass* KartClass = LoadClass<AGoKart>(nullptr, *CVarReplayKartClass.GetValueOnGameThread());
+	if (KartClass == nullptr) KartClass = AGoKart::StaticClass();
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	struct FPlaybackKart
+	{
+		UGoKartMovementComp* MovementComp;
+
+		uint32 LastSequence;
+
+		float LastDeltaTime;
+	};
+	TMap<uint32, FPlaybackKart> Karts;
+
+	int32 NumMoves = 0;
+	int32 NumCheckpoints = 0;
+	int32 NumDiverged = 0;
+	float MaxLocationError = 0;
+	float MaxVelocityError = 0;
+	int32 FirstDivergedFrame = INDEX_NONE;
+	uint32 FirstDivergedKart = 0;
+	bool bParamsDiffer = false;
+	TArray<float> FrameTimes;
+	TArray<uint8> FrameData;
+
+	while (!Reader.AtEnd() && !Reader.IsError())
+	{
+		uint32 NumEvents = 0;
+		uint32 NumBits = 0;
+		Reader.SerializeIntPacked(NumEvents);
+		Reader.SerializeIntPacked(NumBits);
+
+		FrameData.SetNumUninitialized((NumBits + 7) / 8);
+		Reader.Serialize(FrameData.GetData(), FrameData.Num());
+		if (Reader.IsError()) break;
+
+		FBitReader Frame(FrameData.GetData(), NumBits);
+		double FrameSeconds = 0;
+
+		for (uint32 Event = 0; Event < NumEvents && !Frame.IsError(); ++Event)
+		{
+			uint32 Tag = 0;
+			uint32 KartId = 0;
+			Frame.SerializeInt(Tag, NumEventTags);
+			Frame.SerializeIntPacked(KartId);
+
+			if (Tag == SpawnEvent)
+			{
+				FGoKartDynamicsParams Params;
+				FVector Location, Velocity;
+				FQuat Rotation;
+				SerializeSpawn(Frame, Params, Location, Rotation, Velocity);
+
+				AActor* Actor = World->SpawnActor<AActor>(KartClass, Location, Rotation.Rotator(), SpawnParams);
+				UGoKartMovementComp* MovementComp = Actor != nullptr ? Actor->FindComponentByClass<UGoKartMovementComp>() : nullptr;
+				if (MovementComp == nullptr) continue;
+
+				Actor->SetActorLocationAndRotation(Location, Rotation);
+				MovementComp->SetExternalMoveSource(true);
+				MovementComp->SetVelocity(Velocity);
+				bParamsDiffer |= !(MovementComp->GetDynamicsParams() == Params);
+
+				FPlaybackKart& Kart = Karts.Add(KartId);
+				Kart.MovementComp = MovementComp;
+				Kart.LastSequence = 0;
+				Kart.LastDeltaTime = 0;
+			}
+			else if (Tag == MoveEvent)
+			{
+				FPlaybackKart* Kart = Karts.Find(KartId);
+				uint32 UnusedSequence = 0;
+				float UnusedDeltaTime = 0;
+
+				FGoKartMove Move;
+				SerializeMove(Frame, Move, Kart != nullptr ? Kart->LastSequence : UnusedSequence, Kart != nullptr ? Kart->LastDeltaTime : UnusedDeltaTime);
+				if (Kart == nullptr) continue;
+
+				double StartTime = FPlatformTime::Seconds();
+				Kart->MovementComp->SimulateMove(Move);
+				FrameSeconds += FPlatformTime::Seconds() - StartTime;
+				++NumMoves;
+			}
+			else if (Tag == CheckpointEvent)
+			{
+				FVector Location, Velocity;
+				FQuat Rotation;
+				SerializeCheckpoint(Frame, Location, Rotation, Velocity, PositionResolution, VelocityResolution);
+
+				FPlaybackKart* Kart = Karts.Find(KartId);
+				if (Kart == nullptr) continue;
+
+				float LocationError = FVector::Dist(Location, Kart->MovementComp->GetOwner()->GetActorLocation());
+				float VelocityError = FVector::Dist(Velocity, Kart->MovementComp->GetVelocity());
+				MaxLocationError = FMath::Max(MaxLocationError, LocationError);
+				MaxVelocityError = FMath::Max(MaxVelocityError, VelocityError);
+				++NumCheckpoints;
+
+				// Checkpoints are quantized, so allow a grid step of error on each
+				if (LocationError > 2 * PositionResolution || VelocityError > 2 * VelocityResolution)
+				{
+					if (NumDiverged == 0)
+					{
+						FirstDivergedFrame = FrameTimes.Num();
+						FirstDivergedKart = KartId;
+					}
+					++NumDiverged;
+				}
+			}
+		}
+
+		if (Frame.IsError())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Kart recording is corrupt at frame %d."), FrameTimes.Num());
+			break;
+		}
+
+		FrameTimes.Add((float)(FrameSeconds * 1000.0));
+	}
+
+	for (const TPair<uint32, FPlaybackKart>& Kart : Karts) Kart.Value.MovementComp->GetOwner()->Destroy();
+
+	float TotalMs = 0;
+	for (float FrameMs : FrameTimes) TotalMs += FrameMs;
+	FrameTimes.Sort();
+	float P99Ms = FrameTimes.Num() > 0 ? FrameTimes[FMath::Min(FrameTimes.Num() - 1, FMath::FloorToInt(0.99f * FrameTimes.Num()))] : 0.0f;
+
+	if (bParamsDiffer) UE_LOG(LogTemp, Warning, TEXT("Kart tuning differs from the recording, expect divergence."));
+	UE_LOG(LogTemp, Display, TEXT("Kart playback of %s: %d karts, %d frames, %d moves in %.2fms (%.0f moves/s), frame p99 %.3fms max %.3fms"),
+		*Args[0], Karts.Num(), FrameTimes.Num(), NumMoves, TotalMs, NumMoves / FMath::Max(TotalMs / 1000.0f, 0.000001f), P99Ms, FrameTimes.Num() > 0 ? FrameTimes.Last() : 0.0f);
+	UE_LOG(LogTemp, Display, TEXT("  %d of %d checkpoints diverged, max error %.2fcm %.3fm/s"), NumDiverged, NumCheckpoints, MaxLocationError, MaxVelocityError);
+	if (NumDiverged > 0) UE_LOG(LogTemp, Display, TEXT("  first divergence: kart %u in frame %d"), FirstDivergedKart, FirstDivergedFrame);
+
+	if (CVarReplayExitWhenDone.GetValueOnGameThread() != 0) FPlatformMisc::RequestExit(false);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs PlayRecordingCommand(
+	TEXT("kart.Replay.Play"),
+	TEXT("Re-simulates a kart move recording and reports divergence from its checkpoints and simulation time. Args: Path"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&PlayRecording));
@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartRelevancyGrid.h"
+
+void FGoKartRelevancyGrid::Configure(float InCellSize, int32 InViewRadius, int32 InMaxFullRateKarts)
+{
+	InCellSize = FMath::Max(InCellSize, 100.0f);
+	if (InCellSize != CellSize) Reset();
+
+	CellSize = InCellSize;
+	Hysteresis = CellSize * 0.2f;
+	ViewRadius = FMath::Max(InViewRadius, 0);
+	MaxFullRateKarts = FMath::Max(InMaxFullRateKarts, 0);
+}
+
+void FGoKartRelevancyGrid::Reset()
+{
+	Karts.Reset();
+	Cells.Reset();
+	Viewers.Reset();
+	DirtyCells.Reset();
+}
+
+FIntPoint FGoKartRelevancyGrid::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+FIntPoint FGoKartRelevancyGrid::GetCellWithHysteresis(const FVector& Location, const FIntPoint& CurrentCell) const
+{
+	FIntPoint Cell = GetCell(Location);
+	if (Cell == CurrentCell) return CurrentCell;
+
+	// Stay put until we are Hysteresis past the border, so karts on a border don't flip every frame
+	bool bInsideMargin = Location.X >= CurrentCell.X * CellSize - Hysteresis && Location.X < (CurrentCell.X + 1) * CellSize + Hysteresis
+		&& Location.Y >= CurrentCell.Y * CellSize - Hysteresis && Location.Y < (CurrentCell.Y + 1) * CellSize + Hysteresis;
+
+	return bInsideMargin ? CurrentCell : Cell;
+}
+
+void FGoKartRelevancyGrid::UpdateKart(const AActor* Kart, const FVector& Location)
+{
+	FKart* Existing = Karts.Find(Kart);
+	if (Existing == nullptr)
+	{
+		FKart& Added = Karts.Add(Kart);
+		Added.Cell = GetCell(Location);
+		Added.Location = Location;
+		Cells.FindOrAdd(Added.Cell).Add(Kart);
+		DirtyCells.Add(Added.Cell);
+		return;
+	}
+
+	Existing->Location = Location;
+
+	FIntPoint Cell = GetCellWithHysteresis(Location, Existing->Cell);
+	if (Cell == Existing->Cell) return;
+
+	Cells.FindChecked(Existing->Cell).RemoveSwap(Kart);
+	Cells.FindOrAdd(Cell).Add(Kart);
+	DirtyCells.Add(Existing->Cell);
+	DirtyCells.Add(Cell);
+	Existing->Cell = Cell;
+}
+
+void FGoKartRelevancyGrid::RemoveKart(const AActor* Kart)
+{
+	FKart Removed;
+	if (!Karts.RemoveAndCopyValue(Kart, Removed)) return;
+
+	if (TArray<const AActor*>* Cell = Cells.Find(Removed.Cell)) Cell->RemoveSwap(Kart);
+	DirtyCells.Add(Removed.Cell);
+
+	for (TPair<const AActor*, FViewer>& Viewer : Viewers)
+	{
+		Viewer.Value.Relevant.Remove(Kart);
+		Viewer.Value.FullRate.Remove(Kart);
+	}
+}
+
+void FGoKartRelevancyGrid::UpdateViewer(const AActor* Viewer, const FVector& Location, bool bRefreshFullRate)
+{
+	FViewer* Existing = Viewers.Find(Viewer);
+	bool bRebuild = Existing == nullptr;
+
+	if (Existing == nullptr)
+	{
+		Existing = &Viewers.Add(Viewer);
+		Existing->Cell = GetCell(Location);
+	}
+	else
+	{
+		FIntPoint Cell = GetCellWithHysteresis(Location, Existing->Cell);
+		bRebuild = Cell != Existing->Cell || IsNeighbourhoodDirty(Cell);
+		Existing->Cell = Cell;
+	}
+
+	Existing->Location = Location;
+	Existing->LastUpdate = UpdateCount;
+
+	if (bRebuild) RebuildRelevant(*Existing);
+	if (bRebuild || bRefreshFullRate) RebuildFullRate(*Existing);
+}
+
+void FGoKartRelevancyGrid::EndUpdate()
+{
+	for (auto It = Viewers.CreateIterator(); It; ++It)
+	{
+		if (It.Value().LastUpdate != UpdateCount) It.RemoveCurrent();
+	}
+
+	DirtyCells.Reset();
+	++UpdateCount;
+}
+
+bool FGoKartRelevancyGrid::IsNeighbourhoodDirty(const FIntPoint& Cell) const
+{
+	if (DirtyCells.Num() == 0) return false;
+
+	for (const FIntPoint& Dirty : DirtyCells)
+	{
+		if (FMath::Abs(Dirty.X - Cell.X) <= ViewRadius && FMath::Abs(Dirty.Y - Cell.Y) <= ViewRadius) return true;
+	}
+	return false;
+}
+
+void FGoKartRelevancyGrid::RebuildRelevant(FViewer& Viewer)
+{
+	Viewer.Relevant.Reset();
+
+	for (int32 X = Viewer.Cell.X - ViewRadius; X <= Viewer.Cell.X + ViewRadius; ++X)
+	{
+		for (int32 Y = Viewer.Cell.Y - ViewRadius; Y <= Viewer.Cell.Y + ViewRadius; ++Y)
+		{
+			const TArray<const AActor*>* Cell = Cells.Find(FIntPoint(X, Y));
+			if (Cell != nullptr) Viewer.Relevant.Append(*Cell);
+		}
+	}
+}
+
+void FGoKartRelevancyGrid::RebuildFullRate(FViewer& Viewer)
+{
+	Viewer.FullRate.Reset();
+
+	if (Viewer.Relevant.Num() <= MaxFullRateKarts)
+	{
+		Viewer.FullRate.Append(Viewer.Relevant);
+		return;
+	}
+
+	TArray<TPair<float, const AActor*>> ByDistance;
+	ByDistance.Reserve(Viewer.Relevant.Num());
+	for (const AActor* Kart : Viewer.Relevant)
+	{
+		ByDistance.Emplace(FVector::DistSquared(Karts.FindChecked(Kart).Location, Viewer.Location), Kart);
+	}
+
+	ByDistance.Sort([](const TPair<float, const AActor*>& A, const TPair<float, const AActor*>& B) { return A.Key < B.Key; });
+
+	for (int32 Index = 0; Index < MaxFullRateKarts; ++Index) Viewer.FullRate.Add(ByDistance[Index].Value);
+}
+
+bool FGoKartRelevancyGrid::IsRelevant(const AActor* Kart, const AActor* Viewer) const
+{
+	const FViewer* Found = Viewers.Find(Viewer);
+	return Found == nullptr || Found->Relevant.Contains(Kart);
+}
+
+int32 FGoKartRelevancyGrid::GetMaxRelevantCount(const AActor* Kart) const
+{
+	int32 MaxCount = 0;
+	for (const TPair<const AActor*, FViewer>& Viewer : Viewers)
+	{
+		if (Viewer.Value.Relevant.Contains(Kart)) MaxCount = FMath::Max(MaxCount, Viewer.Value.Relevant.Num());
+	}
+	return MaxCount;
+}
+
+bool FGoKartRelevancyGrid::IsOtherKartNear(const AActor* Kart, const FVector& Location, float Distance) const
+{
+	// A kart stays in its cell until it is Hysteresis past the border, so look that much further
+	FVector Reach(Distance + Hysteresis, Distance + Hysteresis, 0);
+	FIntPoint Min = GetCell(Location - Reach);
+	FIntPoint Max = GetCell(Location + Reach);
+
+	float DistanceSquared = FMath::Square(Distance);
+	for (int32 X = Min.X; X <= Max.X; ++X)
+	{
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			const TArray<const AActor*>* Cell = Cells.Find(FIntPoint(X, Y));
+			if (Cell == nullptr) continue;
+
+			for (const AActor* Other : *Cell)
+			{
+				if (Other != Kart && FVector::DistSquared(Karts.FindChecked(Other).Location, Location) < DistanceSquared) return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool FGoKartRelevancyGrid::IsFullRate(const AActor* Kart, const AActor* Viewer) const
+{
+	const FViewer* Found = Viewers.Find(Viewer);
+	return Found == nullptr || Found->FullRate.Contains(Kart);
+}
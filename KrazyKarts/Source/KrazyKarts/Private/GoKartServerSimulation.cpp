@@ -0,0 +1,262 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartServerSimulation.h"
+
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerStart.h"
+#include "HAL/IConsoleManager.h"
+#include "GoKartManager.h"
+#include "GoKartRelevancyGrid.h"
+#include "GoKartStateHistory.h"
+#include "GoKartStats.h"
+#include "GoKartTrackCollision.h"
+
+static TAutoConsoleVariable<int32> CVarParallelMaxTasks(
+	TEXT("kart.Parallel.MaxTasks"),
+	0,
+	TEXT("Most tasks parallel server kart simulation is split into. 0 uses every worker thread and the game thread."));
+
+int32 FGoKartServerSimulation::GetMaxTasks()
+{
+	int32 MaxTasks = CVarParallelMaxTasks.GetValueOnGameThread();
+	if (MaxTasks > 0) return MaxTasks;
+
+	return FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+}
+
+void FGoKartServerSimulation::Simulate(const UWorld* World, const FGoKartTrackCollision* Track, const FGoKartRelevancyGrid* KartGrid, const TArray<FVector>& KartLocations, TArrayView<FGoKartServerSimJob> Jobs, int32 MaxTasks)
+{
+	int32 NumTasks = FMath::Clamp(MaxTasks, 1, FMath::Max(Jobs.Num(), 1));
+
+	// Interleave jobs between tasks, so karts with many queued moves don't all land on one task
+	ParallelFor(NumTasks, [&](int32 Task)
+	{
+		for (int32 Index = Task; Index < Jobs.Num(); Index += NumTasks) SimulateJob(World, Track, KartGrid, KartLocations, Jobs[Index]);
+	}, NumTasks == 1);
+}
+
+// Where a sweep along Translation from Start stops. Backs off a little from a blocking hit, as a component
+// move does, so the next sweep does not start penetrating.
+static FVector GetSweepEnd(const FVector& Start, const FVector& Translation, const FHitResult& Hit, bool bBlocked)
+{
+	if (!bBlocked) return Start + Translation;
+
+	float Distance = Translation.Size();
+	float Time = Distance > KINDA_SMALL_NUMBER ? FMath::Max(0.0f, Hit.Time - 0.1f / Distance) : 0.0f;
+	return Start + Translation * Time;
+}
+
+void FGoKartServerSimulation::SimulateJob(const UWorld* World, const FGoKartTrackCollision* Track, const FGoKartRelevancyGrid* KartGrid, const TArray<FVector>& KartLocations, FGoKartServerSimJob& Job)
+{
+	GOKART_SCOPE_CYCLE_COUNTER(SimulateMove);
+	GOKART_INC_COUNTER(MovesSimulated, Job.Moves.Num());
+
+	for (const FGoKartMove& Move : Job.Moves)
+	{
+		// Same steps as UGoKartMovementComp::SimulateMove, on the job's copy of the kart
+		FGoKartDynamicsKart Kart;
+		Kart.Velocity = Job.Velocity;
+		Kart.Forward = Job.Rotation.GetForwardVector();
+		Kart.Up = Job.Rotation.GetUpVector();
+		Kart.Throttle = Move.Throttle;
+		Kart.SteeringThrow = Move.SteeringThrow;
+		Kart.DeltaTime = Move.DeltaTime;
+
+		FGoKartDynamics::Step(*Job.Params, Kart);
+
+		Job.Velocity = Kart.Velocity;
+		Job.Rotation = FQuat(Kart.Up, Kart.RotationAngle) * Job.Rotation;
+
+		FVector Start = Job.Location;
+		FVector End = Start + Kart.Translation;
+
+		if (Track != nullptr)
+		{
+			float NearDistance = Kart.Translation.Size() + Job.TrackCollisionRadius * 4.0f;
+			bool bNearOtherKart = false;
+			if (KartGrid != nullptr)
+			{
+				bNearOtherKart = KartGrid->IsOtherKartNear(Job.Kart, Start, NearDistance);
+			}
+			else
+			{
+				float NearDistanceSquared = FMath::Square(NearDistance);
+				for (int32 Other = 0; Other < KartLocations.Num() && !bNearOtherKart; ++Other)
+				{
+					bNearOtherKart = Other != Job.KartIndex && FVector::DistSquared(KartLocations[Other], Start) < NearDistanceSquared;
+				}
+			}
+
+			float Time;
+			FGoKartTrackCollision::EMoveResult Result = bNearOtherKart ? FGoKartTrackCollision::EMoveResult::Unknown : Track->Move(Start, Kart.Translation, Job.TrackCollisionRadius, Time);
+			if (Result != FGoKartTrackCollision::EMoveResult::Unknown)
+			{
+				Job.Location = Start + Kart.Translation * Time;
+				if (Result == FGoKartTrackCollision::EMoveResult::Blocked) Job.Velocity = FVector::ZeroVector;
+				continue;
+			}
+		}
+
+		// Scene queries are safe from worker threads, async traces run the same code
+		GOKART_INC_COUNTER(Sweeps, 1);
+		FHitResult Hit;
+		bool bBlocked = World->SweepSingleByChannel(Hit, Start, End, Job.Rotation, Job.Channel, Job.Shape, Job.QueryParams, Job.ResponseParams) && Hit.IsValidBlockingHit();
+
+		// Starting inside something blocks every sweep, so a kart written back overlapping would stay stuck. Push
+		// out along the hit normal, as a component move's depenetration does, and sweep again from there.
+		if (bBlocked && Hit.bStartPenetrating)
+		{
+			Start += Hit.Normal * (Hit.PenetrationDepth + 0.1f);
+			End = Start + Kart.Translation;
+
+			GOKART_INC_COUNTER(Sweeps, 1);
+			bBlocked = World->SweepSingleByChannel(Hit, Start, End, Job.Rotation, Job.Channel, Job.Shape, Job.QueryParams, Job.ResponseParams) && Hit.IsValidBlockingHit();
+
+			// Still inside something, so keep what the push out gained and try again next move
+			if (bBlocked && Hit.bStartPenetrating)
+			{
+				Job.Location = Start;
+				Job.Velocity = FVector::ZeroVector;
+				continue;
+			}
+		}
+
+		// Other karts' histories are only written back after every job has finished
+		AActor* Other = bBlocked && Job.ContactRewindTime > 0.0f ? Hit.GetActor() : nullptr;
+		if (Other != nullptr && !FGoKartLagCompensation::WouldHitRewound(Other, World->TimeSeconds - Job.ContactRewindTime, Start, Kart.Translation, Job.TrackCollisionRadius))
+		{
+			UPrimitiveComponent* PassedThrough = Hit.GetComponent();
+
+			GOKART_INC_COUNTER(Sweeps, 1);
+			FCollisionQueryParams QueryParams = Job.QueryParams;
+			QueryParams.AddIgnoredActor(Other);
+			bBlocked = World->SweepSingleByChannel(Hit, Start, End, Job.Rotation, Job.Channel, Job.Shape, QueryParams, Job.ResponseParams) && Hit.IsValidBlockingHit();
+
+			Job.Location = GetSweepEnd(Start, Kart.Translation, Hit, bBlocked);
+			if (bBlocked) Job.Velocity = FVector::ZeroVector;
+
+			// As in UGoKartMovementComp::SweepPastUnseenKart, push out of the kart we passed through, or its own
+			// sweeps start inside us and stop it dead every move until we leave
+			FMTDResult Penetration;
+			if (PassedThrough != nullptr && PassedThrough->ComputePenetration(Penetration, Job.Shape, Job.Location, Job.Rotation))
+			{
+				GOKART_INC_COUNTER(Sweeps, 1);
+				FVector PushOut = Penetration.Direction * (Penetration.Distance + 0.1f);
+				FHitResult PushOutHit;
+				bool bPushOutBlocked = World->SweepSingleByChannel(PushOutHit, Job.Location, Job.Location + PushOut, Job.Rotation, Job.Channel, Job.Shape, QueryParams, Job.ResponseParams) && PushOutHit.IsValidBlockingHit();
+				Job.Location = GetSweepEnd(Job.Location, PushOut, PushOutHit, bPushOutBlocked);
+			}
+			continue;
+		}
+
+		Job.Location = GetSweepEnd(Start, Kart.Translation, Hit, bBlocked);
+		if (bBlocked) Job.Velocity = FVector::ZeroVector;
+	}
+}
+
+static void RunServerSimulationBenchmark(const TArray<FString>& Args, UWorld* World)
+{
+	if (World == nullptr) return;
+
+	int32 NumKarts = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 64;
+	int32 MovesPerKart = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 4;
+	int32 Iterations = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 50;
+
+	FVector Origin = FVector(0, 0, 100);
+	TActorIterator<APlayerStart> PlayerStart(World);
+	if (PlayerStart) Origin = PlayerStart->GetActorLocation();
+
+	FGoKartDynamicsParams Params;
+	Params.GravityZ = World->GetGravityZ();
+	Params.UpdateDerived();
+
+	// Karts 5m apart on a square grid, as the load test spawns them, driving with random input
+	const float Spacing = 500.0f;
+	int32 Columns = FMath::CeilToInt(FMath::Sqrt((float)NumKarts));
+	FRandomStream Random(0);
+
+	TArray<FGoKartServerSimJob> TemplateJobs;
+	TArray<FVector> KartLocations;
+	for (int32 Index = 0; Index < NumKarts; ++Index)
+	{
+		FGoKartServerSimJob Job;
+		Job.Params = &Params;
+		Job.Shape = FCollisionShape::MakeBox(FVector(90.0f, 60.0f, 30.0f));
+		Job.Channel = ECC_Pawn;
+		Job.QueryParams = FCollisionQueryParams(FName(TEXT("GoKartBenchmark")), false);
+		Job.TrackCollisionRadius = 60.0f;
+		Job.ContactRewindTime = 0.0f;
+		Job.KartIndex = Index;
+		Job.Kart = nullptr;
+		Job.Location = Origin + FVector((Index / Columns) * Spacing, (Index % Columns) * Spacing, 0);
+		Job.Rotation = FRotator(0, Random.FRandRange(-180.0f, 180.0f), 0).Quaternion();
+		Job.Velocity = Job.Rotation.GetForwardVector() * 10.0f;
+
+		for (int32 MoveIndex = 0; MoveIndex < MovesPerKart; ++MoveIndex)
+		{
+			FGoKartMove Move;
+			Move.Throttle = Random.FRandRange(0.3f, 1.0f);
+			Move.SteeringThrow = Random.FRandRange(-1.0f, 1.0f);
+			Move.DeltaTime = 1.0f / 60.0f;
+			Move.Time = 0;
+			Move.Sequence = MoveIndex + 1;
+			Job.Moves.Add(Move);
+		}
+
+		KartLocations.Add(Job.Location);
+		TemplateJobs.Add(Job);
+	}
+
+	AGoKartManager* Manager = AGoKartManager::Get(World);
+	const FGoKartTrackCollision* Track = Manager != nullptr ? Manager->GetTrackCollision() : nullptr;
+
+	int32 MaxTasks = FGoKartServerSimulation::GetMaxTasks();
+	TArray<int32> TaskCounts;
+	for (int32 Tasks = 1; Tasks < MaxTasks; Tasks *= 2) TaskCounts.Add(Tasks);
+	TaskCounts.Add(MaxTasks);
+
+	UE_LOG(LogTemp, Display, TEXT("Kart server simulation: %d karts, %d moves each, %d iterations, track grid %s"), NumKarts, MovesPerKart, Iterations, Track != nullptr ? TEXT("on") : TEXT("off"));
+
+	TArray<FGoKartServerSimJob> Reference;
+	double SingleTaskMs = 0;
+
+	for (int32 Tasks : TaskCounts)
+	{
+		TArray<FGoKartServerSimJob> Jobs;
+		double TotalSeconds = 0;
+
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			Jobs = TemplateJobs;
+
+			double StartTime = FPlatformTime::Seconds();
+			FGoKartServerSimulation::Simulate(World, Track, nullptr, KartLocations, Jobs, Tasks);
+			TotalSeconds += FPlatformTime::Seconds() - StartTime;
+		}
+
+		double FrameMs = TotalSeconds * 1000.0 / Iterations;
+		if (Tasks == 1)
+		{
+			Reference = Jobs;
+			SingleTaskMs = FrameMs;
+		}
+
+		bool bMatches = true;
+		for (int32 Index = 0; Index < Jobs.Num() && bMatches; ++Index)
+		{
+			bMatches = Jobs[Index].Location == Reference[Index].Location && Jobs[Index].Velocity == Reference[Index].Velocity
+				&& Jobs[Index].Rotation == Reference[Index].Rotation;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("  %2d tasks: %8.3f ms  %5.2fx  %s"), Tasks, FrameMs, SingleTaskMs / FMath::Max(FrameMs, 0.000001), bMatches ? TEXT("matches 1 task") : TEXT("DIFFERS from 1 task"));
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ServerSimulationBenchmarkCommand(
+	TEXT("kart.Parallel.Benchmark"),
+	TEXT("Times parallel server kart simulation from 1 task up to kart.Parallel.MaxTasks. Args: [NumKarts] [MovesPerKart] [Iterations]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunServerSimulationBenchmark));
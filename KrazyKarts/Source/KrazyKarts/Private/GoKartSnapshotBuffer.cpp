@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSnapshotBuffer.h"
+
+void FGoKartSnapshotBuffer::Add(const FGoKartSnapshot& Snapshot)
+{
+	if (Count > 0 && Snapshot.Time <= Newest().Time) return;
+
+	if (Count == Capacity)
+	{
+		Head = (Head + 1) & (Capacity - 1);
+		--Count;
+	}
+
+	Snapshots[(Head + Count) & (Capacity - 1)] = Snapshot;
+	++Count;
+}
+
+bool FGoKartSnapshotBuffer::Sample(float Time, float MaxExtrapolationTime, FGoKartSnapshot& OutSnapshot) const
+{
+	if (Count == 0) return false;
+
+	OutSnapshot.Time = Time;
+
+	const FGoKartSnapshot& Oldest = (*this)[0];
+	if (Time <= Oldest.Time)
+	{
+		OutSnapshot = Oldest;
+		return true;
+	}
+
+	const FGoKartSnapshot& Latest = Newest();
+	if (Time >= Latest.Time)
+	{
+		// MPS * 100 = CMPS
+		float ExtrapolationTime = FMath::Min(Time - Latest.Time, MaxExtrapolationTime);
+		OutSnapshot.Location = Latest.Location + Latest.Velocity * 100 * ExtrapolationTime;
+		OutSnapshot.Rotation = Latest.Rotation;
+		OutSnapshot.Velocity = Latest.Velocity;
+		return true;
+	}
+
+	int32 Index = FindSegment(Time);
+	const FGoKartSnapshot& Start = (*this)[Index];
+	const FGoKartSnapshot& Target = (*this)[Index + 1];
+
+	float SegmentTime = Target.Time - Start.Time;
+	float LerpRatio = (Time - Start.Time) / SegmentTime;
+
+	// Multiplied by 100 to go from M to CM
+	float VelocityToDerivative = SegmentTime * 100;
+	FVector StartDerivative = Start.Velocity * VelocityToDerivative;
+	FVector TargetDerivative = Target.Velocity * VelocityToDerivative;
+
+	OutSnapshot.Location = FMath::CubicInterp(Start.Location, StartDerivative, Target.Location, TargetDerivative, LerpRatio);
+	OutSnapshot.Velocity = FMath::CubicInterpDerivative(Start.Location, StartDerivative, Target.Location, TargetDerivative, LerpRatio) / VelocityToDerivative;
+	// Normalized lerp, as FGoKartProxySmoothingBatch evaluates the same segment, so batched and unbatched proxies match
+	OutSnapshot.Rotation = FQuat::FastLerp(Start.Rotation, Target.Rotation, LerpRatio).GetNormalized();
+	return true;
+}
+
+int32 FGoKartSnapshotBuffer::FindSegment(float Time) const
+{
+	if (Count < 2 || Time <= (*this)[0].Time || Time >= Newest().Time) return INDEX_NONE;
+
+	int32 Index = Count - 2;
+	while (Index > 0 && (*this)[Index].Time > Time) --Index;
+	return Index;
+}
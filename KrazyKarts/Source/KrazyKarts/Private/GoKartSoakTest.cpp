@@ -0,0 +1,273 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSoakTest.h"
+
+#include "Engine/Engine.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UnrealNetwork.h"
+#include "GoKart.h"
+
+static TAutoConsoleVariable<float> CVarSoakMaxCorrectionsPerMinute(
+	TEXT("kart.Soak.MaxCorrectionsPerMinute"),
+	30.0f,
+	TEXT("Soak test fails when a client's kart is corrected more often than this. 0 disables the check."));
+
+static TAutoConsoleVariable<float> CVarSoakMaxMeanCorrection(
+	TEXT("kart.Soak.MaxMeanCorrection"),
+	30.0f,
+	TEXT("Soak test fails when a client's mean correction is larger than this (cm). 0 disables the check."));
+
+static TAutoConsoleVariable<float> CVarSoakMaxMeanProxyError(
+	TEXT("kart.Soak.MaxMeanProxyError"),
+	20.0f,
+	TEXT("Soak test fails when simulated proxies are drawn further than this from the server on average (cm). 0 disables the check."));
+
+static TAutoConsoleVariable<float> CVarSoakMaxBytesPerSecond(
+	TEXT("kart.Soak.MaxBytesPerSecond"),
+	16000.0f,
+	TEXT("Soak test fails when any connection averages more than this in either direction. 0 disables the check."));
+
+static void StartSoakTest(const TArray<FString>& Args, UWorld* World)
+{
+	AGoKartSoakTest::Start(World, Args);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs StartSoakTestCommand(
+	TEXT("kart.Soak.Start"),
+	TEXT("Runs a network soak test on this server and its clients. Args: Duration MinClients PktLagMs PktLagVarianceMs PktLossPercent [CsvPath]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StartSoakTest));
+
+AGoKartSoakTest::FOnFinished AGoKartSoakTest::OnFinished;
+
+AGoKartSoakTest* AGoKartSoakTest::Start(UWorld* World, const TArray<FString>& Args)
+{
+	if (World == nullptr || World->GetNetMode() == NM_Client || World->GetNetMode() == NM_Standalone)
+	{
+		UE_LOG(LogTemp, Error, TEXT("kart.Soak.Start must run on a listen or dedicated server."));
+		return nullptr;
+	}
+
+	float Duration = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 300.0f;
+	int32 MinClients = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1;
+	int32 PktLag = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 100;
+	int32 PktLagVariance = Args.Num() > 3 ? FCString::Atoi(*Args[3]) : 20;
+	int32 PktLoss = Args.Num() > 4 ? FCString::Atoi(*Args[4]) : 1;
+	FString CsvPath = Args.Num() > 5 ? Args[5] : FString();
+
+	AGoKartSoakTest* SoakTest = World->SpawnActor<AGoKartSoakTest>();
+	if (SoakTest != nullptr) SoakTest->StartTest(Duration, MinClients, PktLag, PktLagVariance, PktLoss, CsvPath);
+	return SoakTest;
+}
+
+AGoKartSoakTest::AGoKartSoakTest()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	bReplicates = true;
+	bAlwaysRelevant = true;
+	NetUpdateFrequency = 10.0f;
+}
+
+void AGoKartSoakTest::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AGoKartSoakTest, TestDuration);
+	DOREPLIFETIME(AGoKartSoakTest, PktLag);
+	DOREPLIFETIME(AGoKartSoakTest, PktLagVariance);
+	DOREPLIFETIME(AGoKartSoakTest, PktLoss);
+	DOREPLIFETIME(AGoKartSoakTest, bRunning);
+}
+
+void AGoKartSoakTest::StartTest(float Duration, int32 InMinClients, int32 InPktLag, int32 InPktLagVariance, int32 InPktLoss, const FString& InCsvPath)
+{
+	TestDuration = Duration;
+	MinClients = InMinClients;
+	PktLag = InPktLag;
+	PktLagVariance = InPktLagVariance;
+	PktLoss = InPktLoss;
+	CsvPath = InCsvPath;
+
+	UE_LOG(LogTemp, Display, TEXT("Kart soak test: waiting for %d clients"), MinClients);
+}
+
+void AGoKartSoakTest::OnRep_Running()
+{
+	if (bRunning && TestTime == 0) BeginTest();
+}
+
+void AGoKartSoakTest::BeginTest()
+{
+	// Each process delays, jitters and drops its own outgoing packets, so both directions are covered
+	GEngine->Exec(GetWorld(), *FString::Printf(TEXT("Net PktLag=%d"), PktLag));
+	GEngine->Exec(GetWorld(), *FString::Printf(TEXT("Net PktLagVariance=%d"), PktLagVariance));
+	GEngine->Exec(GetWorld(), *FString::Printf(TEXT("Net PktLoss=%d"), PktLoss));
+
+	const TCHAR* Side = Role == ROLE_Authority ? TEXT("Server") : TEXT("Client");
+	if (CsvPath.IsEmpty()) CsvPath = FPaths::GameSavedDir() / TEXT("Soak") / FString::Printf(TEXT("KartSoak-%s-%u-%s.csv"), Side, FPlatformProcess::GetCurrentProcessId(), *FDateTime::Now().ToString());
+
+	CsvLines.Add(TEXT("Time,Connection,InBytesPerSec,OutBytesPerSec,Corrections,MeanCorrectionCm,MaxCorrectionCm,ProxyUpdates,MeanProxyErrorCm,MaxProxyErrorCm"));
+
+	// Drop whatever error built up before the test, e.g. while spawning
+	FGoKartNetErrorStats Discarded;
+	for (TActorIterator<AGoKart> Kart(GetWorld()); Kart; ++Kart)
+	{
+		UGoKartMovementReplicator* Replicator = Kart->FindComponentByClass<UGoKartMovementReplicator>();
+		if (Replicator != nullptr) Replicator->TakeErrorStats(Discarded);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Kart soak test: %s for %.0fs with %dms lag, %dms variance and %d%% loss, writing %s"), Side, TestDuration, PktLag, PktLagVariance, PktLoss, *CsvPath);
+}
+
+void AGoKartSoakTest::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Role == ROLE_Authority && !bRunning)
+	{
+		TArray<UNetConnection*> Connections;
+		GetConnections(Connections);
+		if (Connections.Num() < MinClients) return;
+
+		bRunning = true;
+		BeginTest();
+	}
+
+	if (!bRunning || bFinished) return;
+
+	DriveLocalKart();
+
+	TestTime += DeltaTime;
+	TimeSinceRow += DeltaTime;
+
+	if (TimeSinceRow >= 1.0f) WriteRow();
+
+	if (TestTime < TestDuration) return;
+
+	FinishTest();
+
+	// Give clients time to finish and report before the test goes away under them
+	if (Role == ROLE_Authority) SetLifeSpan(5.0f);
+}
+
+void AGoKartSoakTest::DriveLocalKart()
+{
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	AGoKart* Kart = PlayerController != nullptr ? Cast<AGoKart>(PlayerController->GetPawn()) : nullptr;
+	UGoKartMovementComp* MovementComp = Kart != nullptr ? Kart->FindComponentByClass<UGoKartMovementComp>() : nullptr;
+	if (MovementComp == nullptr || !Kart->IsLocallyControlled()) return;
+
+	// Keep the input bindings from overwriting the script
+	if (Kart->InputEnabled()) Kart->DisableInput(PlayerController);
+
+	// Weave at full throttle, with a hard turn every 7s and a brake every 10s, where prediction is hardest
+	bool bHardTurn = FMath::Fmod(TestTime, 7.0f) < 1.0f;
+	bool bBraking = FMath::Fmod(TestTime, 10.0f) >= 8.5f;
+	MovementComp->SetThrottle(bBraking ? -1.0f : 1.0f);
+	MovementComp->SetSteeringThrow(bHardTurn ? 1.0f : 0.5f * FMath::Sin(TestTime * 0.8f));
+}
+
+void AGoKartSoakTest::GetConnections(TArray<UNetConnection*>& OutConnections) const
+{
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	if (NetDriver == nullptr) return;
+
+	if (NetDriver->ServerConnection != nullptr) OutConnections.Add(NetDriver->ServerConnection);
+
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		if (Connection != nullptr && Connection->State == USOCK_Open) OutConnections.Add(Connection);
+	}
+}
+
+void AGoKartSoakTest::WriteRow()
+{
+	FGoKartNetErrorStats RowStats;
+	for (TActorIterator<AGoKart> Kart(GetWorld()); Kart; ++Kart)
+	{
+		UGoKartMovementReplicator* Replicator = Kart->FindComponentByClass<UGoKartMovementReplicator>();
+		if (Replicator != nullptr) Replicator->TakeErrorStats(RowStats);
+	}
+	TotalErrorStats.Accumulate(RowStats);
+
+	float MeanCorrection = RowStats.Corrections > 0 ? RowStats.TotalCorrectionSize / RowStats.Corrections : 0.0f;
+	float MeanProxyError = RowStats.ProxyUpdates > 0 ? RowStats.TotalProxyError / RowStats.ProxyUpdates : 0.0f;
+
+	TArray<UNetConnection*> Connections;
+	GetConnections(Connections);
+
+	// Connections update their byte rates once a second
+	for (UNetConnection* Connection : Connections)
+	{
+		FString Address = Connection->LowLevelGetRemoteAddress(true);
+
+		FConnectionTotals& Totals = ConnectionTotals.FindOrAdd(Address);
+		Totals.InBytes += Connection->InBytesPerSecond * TimeSinceRow;
+		Totals.OutBytes += Connection->OutBytesPerSecond * TimeSinceRow;
+		Totals.Time += TimeSinceRow;
+
+		CsvLines.Add(FString::Printf(TEXT("%.2f,%s,%d,%d,%u,%.2f,%.2f,%u,%.2f,%.2f"), TestTime, *Address, Connection->InBytesPerSecond, Connection->OutBytesPerSecond,
+			RowStats.Corrections, MeanCorrection, RowStats.MaxCorrectionSize, RowStats.ProxyUpdates, MeanProxyError, RowStats.MaxProxyError));
+	}
+
+	TimeSinceRow = 0;
+}
+
+void AGoKartSoakTest::FinishTest()
+{
+	bFinished = true;
+
+	TArray<FString> Failures;
+
+	float Minutes = FMath::Max(TestTime / 60.0f, 0.001f);
+	float CorrectionsPerMinute = TotalErrorStats.Corrections / Minutes;
+	float MeanCorrection = TotalErrorStats.Corrections > 0 ? TotalErrorStats.TotalCorrectionSize / TotalErrorStats.Corrections : 0.0f;
+	float MeanProxyError = TotalErrorStats.ProxyUpdates > 0 ? TotalErrorStats.TotalProxyError / TotalErrorStats.ProxyUpdates : 0.0f;
+
+	float MaxCorrectionsPerMinute = CVarSoakMaxCorrectionsPerMinute.GetValueOnGameThread();
+	float MaxMeanCorrection = CVarSoakMaxMeanCorrection.GetValueOnGameThread();
+	float MaxMeanProxyError = CVarSoakMaxMeanProxyError.GetValueOnGameThread();
+	float MaxBytesPerSecond = CVarSoakMaxBytesPerSecond.GetValueOnGameThread();
+
+	if (MaxCorrectionsPerMinute > 0 && CorrectionsPerMinute > MaxCorrectionsPerMinute) Failures.Add(FString::Printf(TEXT("%.1f corrections/min > %.1f"), CorrectionsPerMinute, MaxCorrectionsPerMinute));
+	if (MaxMeanCorrection > 0 && MeanCorrection > MaxMeanCorrection) Failures.Add(FString::Printf(TEXT("mean correction %.1fcm > %.1fcm"), MeanCorrection, MaxMeanCorrection));
+	if (MaxMeanProxyError > 0 && MeanProxyError > MaxMeanProxyError) Failures.Add(FString::Printf(TEXT("mean proxy error %.1fcm > %.1fcm"), MeanProxyError, MaxMeanProxyError));
+
+	for (const TPair<FString, FConnectionTotals>& Connection : ConnectionTotals)
+	{
+		float Time = FMath::Max(Connection.Value.Time, 1.0f);
+		float InBytesPerSecond = Connection.Value.InBytes / Time;
+		float OutBytesPerSecond = Connection.Value.OutBytes / Time;
+		UE_LOG(LogTemp, Display, TEXT("  %s: in %.0f B/s, out %.0f B/s"), *Connection.Key, InBytesPerSecond, OutBytesPerSecond);
+
+		if (MaxBytesPerSecond > 0 && FMath::Max(InBytesPerSecond, OutBytesPerSecond) > MaxBytesPerSecond)
+		{
+			Failures.Add(FString::Printf(TEXT("%s averaged %.0f B/s > %.0f B/s"), *Connection.Key, FMath::Max(InBytesPerSecond, OutBytesPerSecond), MaxBytesPerSecond));
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("  %u corrections (%.1f/min), mean %.1fcm max %.1fcm; %u proxy updates, mean error %.1fcm max %.1fcm"),
+		TotalErrorStats.Corrections, CorrectionsPerMinute, MeanCorrection, TotalErrorStats.MaxCorrectionSize, TotalErrorStats.ProxyUpdates, MeanProxyError, TotalErrorStats.MaxProxyError);
+
+	if (Failures.Num() == 0) UE_LOG(LogTemp, Display, TEXT("Kart soak test PASSED"));
+	else UE_LOG(LogTemp, Error, TEXT("Kart soak test FAILED: %s"), *FString::Join(Failures, TEXT("; ")));
+
+	if (!FFileHelper::SaveStringArrayToFile(CsvLines, *CsvPath)) UE_LOG(LogTemp, Error, TEXT("Kart soak test could not write %s"), *CsvPath);
+
+	OnFinished.Broadcast(GetWorld(), Failures);
+}
+
+void AGoKartSoakTest::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	// The server went away, or travelled, before we finished: report what was measured
+	if (bRunning && !bFinished && TestTime > 0) FinishTest();
+}
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartStateHistory.h"
+
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+#include "GoKartMovementReplicator.h"
+
+static TAutoConsoleVariable<int32> CVarLagCompKartContacts(
+	TEXT("kart.LagComp.KartContacts"),
+	1,
+	TEXT("Resolve kart-on-kart contacts against where the instigating client saw the other kart, up to each kart's MaxContactRewindTime."));
+
+void FGoKartStateHistory::Add(const FGoKartSnapshot& Snapshot)
+{
+	if (Count > 0)
+	{
+		FGoKartSnapshot& Newest = Snapshots[(Head + Count - 1) & (Capacity - 1)];
+		if (Snapshot.Time < Newest.Time) return;
+
+		// Several moves simulated in one server frame share its time, keep the last
+		if (Snapshot.Time == Newest.Time)
+		{
+			Newest = Snapshot;
+			return;
+		}
+	}
+
+	if (Count == Capacity)
+	{
+		Head = (Head + 1) & (Capacity - 1);
+		--Count;
+	}
+
+	Snapshots[(Head + Count) & (Capacity - 1)] = Snapshot;
+	++Count;
+}
+
+bool FGoKartStateHistory::Rewind(float Time, FGoKartSnapshot& OutSnapshot) const
+{
+	if (Count == 0) return false;
+
+	if (Time <= (*this)[0].Time)
+	{
+		OutSnapshot = (*this)[0];
+		return true;
+	}
+
+	if (Time >= (*this)[Count - 1].Time)
+	{
+		OutSnapshot = (*this)[Count - 1];
+		return true;
+	}
+
+	// First snapshot after Time. Snapshots are in time order and the ends were handled above.
+	int32 Low = 1;
+	int32 High = Count - 1;
+	while (Low < High)
+	{
+		int32 Middle = (Low + High) / 2;
+		if ((*this)[Middle].Time > Time) High = Middle;
+		else Low = Middle + 1;
+	}
+
+	const FGoKartSnapshot& Before = (*this)[Low - 1];
+	const FGoKartSnapshot& After = (*this)[Low];
+	float Alpha = (Time - Before.Time) / (After.Time - Before.Time);
+
+	OutSnapshot.Time = Time;
+	OutSnapshot.Location = FMath::Lerp(Before.Location, After.Location, Alpha);
+	OutSnapshot.Rotation = FQuat::Slerp(Before.Rotation, After.Rotation, Alpha);
+	OutSnapshot.Velocity = FMath::Lerp(Before.Velocity, After.Velocity, Alpha);
+
+	return true;
+}
+
+bool FGoKartLagCompensation::IsEnabled()
+{
+	return CVarLagCompKartContacts.GetValueOnAnyThread() != 0;
+}
+
+bool FGoKartLagCompensation::WouldHitRewound(const AActor* Other, float RewoundTime, const FVector& Start, const FVector& Translation, float Radius)
+{
+	if (Other == nullptr) return true;
+
+	const UGoKartMovementReplicator* Replicator = Other->FindComponentByClass<UGoKartMovementReplicator>();
+	if (Replicator == nullptr || Replicator->MovementComp == nullptr) return true;
+
+	FGoKartSnapshot Rewound;
+	if (!Replicator->GetServerStateHistory().Rewind(RewoundTime, Rewound)) return true;
+
+	FVector Closest = FMath::ClosestPointOnSegment(Rewound.Location, Start, Start + Translation);
+	float ContactDistance = Radius + Replicator->MovementComp->GetTrackCollisionRadius();
+
+	return FVector::DistSquared(Closest, Rewound.Location) < FMath::Square(ContactDistance);
+}
@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartStats.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Paths.h"
+#include "Misc/App.h"
+
+DEFINE_STAT(STAT_GoKart_SimulateMove);
+DEFINE_STAT(STAT_GoKart_AutonomousProxyOnRep);
+DEFINE_STAT(STAT_GoKart_ClearAcknowledgedMoves);
+DEFINE_STAT(STAT_GoKart_ClientTick);
+DEFINE_STAT(STAT_GoKart_ServerReceiveMoves);
+DEFINE_STAT(STAT_GoKart_ServerDrainMoves);
+
+DEFINE_STAT(STAT_GoKart_MovesSimulated);
+DEFINE_STAT(STAT_GoKart_MovesReplayed);
+DEFINE_STAT(STAT_GoKart_Sweeps);
+DEFINE_STAT(STAT_GoKart_Corrections);
+DEFINE_STAT(STAT_GoKart_UnacknowledgedMoves);
+
+bool FGoKartStats::bCapturing = false;
+volatile int32 FGoKartStats::Counters[FGoKartStats::NumCounters];
+volatile int32 FGoKartStats::TimerCycles[FGoKartStats::NumTimers];
+
+namespace
+{
+	FArchive* CsvWriter = nullptr;
+
+	FDelegateHandle EndFrameHandle;
+
+	void WriteLine(const FString& Line)
+	{
+		FTCHARToUTF8 Converted(*(Line + LINE_TERMINATOR));
+		CsvWriter->Serialize((void*)Converted.Get(), Converted.Length());
+	}
+}
+
+void FGoKartStats::StartCsv(const FString& Path)
+{
+	StopCsv();
+
+	CsvWriter = IFileManager::Get().CreateFileWriter(*Path);
+	if (CsvWriter == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not open %s for kart stats."), *Path);
+		return;
+	}
+
+	WriteLine(TEXT("Frame,FrameMs,MovesSimulated,MovesReplayed,Sweeps,Corrections,UnacknowledgedMoves,")
+		TEXT("SimulateMoveMs,AutonomousProxyOnRepMs,ClearAcknowledgedMovesMs,ClientTickMs,ServerReceiveMovesMs,ServerDrainMovesMs"));
+
+	FMemory::Memzero((void*)Counters, sizeof(Counters));
+	FMemory::Memzero((void*)TimerCycles, sizeof(TimerCycles));
+
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&FGoKartStats::WriteFrame);
+	bCapturing = true;
+
+	UE_LOG(LogTemp, Display, TEXT("Capturing kart stats to %s"), *Path);
+}
+
+void FGoKartStats::StopCsv()
+{
+	if (CsvWriter == nullptr) return;
+
+	bCapturing = false;
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+
+	CsvWriter->Close();
+	delete CsvWriter;
+	CsvWriter = nullptr;
+}
+
+void FGoKartStats::WriteFrame()
+{
+	FString Line = FString::Printf(TEXT("%llu,%.3f"), (uint64)GFrameCounter, FApp::GetDeltaTime() * 1000.0);
+
+	for (int32 Counter = 0; Counter < NumCounters; ++Counter)
+	{
+		Line += FString::Printf(TEXT(",%d"), FPlatformAtomics::InterlockedExchange(&Counters[Counter], 0));
+	}
+	for (int32 Timer = 0; Timer < NumTimers; ++Timer)
+	{
+		uint32 Cycles = (uint32)FPlatformAtomics::InterlockedExchange(&TimerCycles[Timer], 0);
+		Line += FString::Printf(TEXT(",%.4f"), FPlatformTime::ToMilliseconds(Cycles));
+	}
+
+	WriteLine(Line);
+}
+
+static void StartCsvCommand(const TArray<FString>& Args)
+{
+	FString Path = Args.Num() > 0 ? Args[0] : FPaths::ProfilingDir() / FString::Printf(TEXT("KartStats-%s.csv"), *FDateTime::Now().ToString());
+	FGoKartStats::StartCsv(Path);
+}
+
+static FAutoConsoleCommand StartCsvConsoleCommand(
+	TEXT("kart.Stats.StartCsv"),
+	TEXT("Writes one row of kart movement and replication counters per frame to CSV. Args: [Path]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&StartCsvCommand));
+
+static FAutoConsoleCommand StopCsvConsoleCommand(
+	TEXT("kart.Stats.StopCsv"),
+	TEXT("Stops a kart stats CSV capture."),
+	FConsoleCommandDelegate::CreateStatic(&FGoKartStats::StopCsv));
@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartTrackCollision.h"
+
+#include "Engine/World.h"
+#include "Components/PrimitiveComponent.h"
+
+bool FGoKartTrackCollision::Bake(UWorld* World, const FBox& Bounds, float InCellSize, float InMaxStepHeight, const TArray<AActor*>& IgnoredActors)
+{
+	Reset();
+
+	if (World == nullptr || !Bounds.IsValid) return false;
+
+	double StartTime = FPlatformTime::Seconds();
+
+	CellSize = FMath::Max(InCellSize, 1.0f);
+	InvCellSize = 1.0f / CellSize;
+	Origin = FVector2D(Bounds.Min);
+	BaseZ = Bounds.Min.Z;
+	MaxStepHeight = FMath::CeilToInt(InMaxStepHeight);
+
+	FVector Size = Bounds.GetSize();
+	SizeX = FMath::Max(FMath::CeilToInt(Size.X * InvCellSize), 1);
+	SizeY = FMath::Max(FMath::CeilToInt(Size.Y * InvCellSize), 1);
+
+	// Heights are int16 cm, and a runaway bounds should not eat the heap
+	const int64 MaxCells = 16 * 1024 * 1024;
+	if ((int64)SizeX * SizeY > MaxCells || Size.Z > MAX_int16)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Track collision not baked, %dx%d cells of %.0fcm over %.0fcm of height is too large."), SizeX, SizeY, CellSize, Size.Z);
+		SizeX = SizeY = 0;
+		return false;
+	}
+
+	Heights.SetNumZeroed(SizeX * SizeY);
+	Flags.SetNumZeroed(SizeX * SizeY);
+
+	FCollisionQueryParams QueryParams(FName(TEXT("GoKartTrackBake")), false);
+	QueryParams.AddIgnoredActors(IgnoredActors);
+
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldStatic);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+
+	// Sweep a cell sized box so walls thinner than a cell are still caught. The first hit is the highest surface.
+	FCollisionShape CellShape = FCollisionShape::MakeBox(FVector(CellSize * 0.5f, CellSize * 0.5f, 1.0f));
+	float TopZ = Bounds.Max.Z + 10.0f;
+	float BottomZ = Bounds.Min.Z - 10.0f;
+
+	for (int32 Y = 0; Y < SizeY; ++Y)
+	{
+		for (int32 X = 0; X < SizeX; ++X)
+		{
+			int32 Index = GetCellIndex(X, Y);
+			FVector2D Center = Origin + FVector2D(X + 0.5f, Y + 0.5f) * CellSize;
+
+			FHitResult Hit;
+			if (!World->SweepSingleByObjectType(Hit, FVector(Center, TopZ), FVector(Center, BottomZ), FQuat::Identity, ObjectParams, CellShape, QueryParams))
+			{
+				Flags[Index] |= Empty;
+				continue;
+			}
+
+			Heights[Index] = (int16)FMath::Clamp(FMath::RoundToInt(Hit.ImpactPoint.Z - BaseZ), 0, (int32)MAX_int16);
+
+			UPrimitiveComponent* Component = Hit.GetComponent();
+			if (Component != nullptr && Component->Mobility != EComponentMobility::Static) Flags[Index] |= Dynamic;
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Baked %dx%d track collision cells of %.0fcm in %.1fms, %d KB."),
+		SizeX, SizeY, CellSize, (FPlatformTime::Seconds() - StartTime) * 1000.0, GetAllocatedSize() / 1024);
+
+	return true;
+}
+
+void FGoKartTrackCollision::Reset()
+{
+	Heights.Empty();
+	Flags.Empty();
+	SizeX = SizeY = 0;
+}
+
+FIntPoint FGoKartTrackCollision::GetCell(const FVector2D& Location) const
+{
+	return FIntPoint(FMath::FloorToInt((Location.X - Origin.X) * InvCellSize), FMath::FloorToInt((Location.Y - Origin.Y) * InvCellSize));
+}
+
+bool FGoKartTrackCollision::GetFloorHeight(const FVector2D& Location, int32& OutHeight) const
+{
+	FIntPoint Cell = GetCell(Location);
+	if (Cell.X < 0 || Cell.Y < 0 || Cell.X >= SizeX || Cell.Y >= SizeY) return false;
+
+	int32 Index = GetCellIndex(Cell.X, Cell.Y);
+	if (Flags[Index] != 0) return false;
+
+	OutHeight = Heights[Index];
+	return true;
+}
+
+FGoKartTrackCollision::EMoveResult FGoKartTrackCollision::Move(const FVector& Start, const FVector& Translation, float Radius, float& OutTime) const
+{
+	OutTime = 1.0f;
+
+	if (!IsBaked()) return EMoveResult::Unknown;
+
+	FVector2D Start2D(Start);
+	FVector2D Translation2D(Translation);
+
+	int32 FloorHeight;
+	if (!GetFloorHeight(Start2D, FloorHeight)) return EMoveResult::Unknown;
+
+	int32 WallHeight = FloorHeight + MaxStepHeight;
+
+	// Cells the kart already overlaps never block it, so a kart resting against a wall can still drive away
+	FIntPoint StartMin = GetCell(Start2D - FVector2D(Radius, Radius));
+	FIntPoint StartMax = GetCell(Start2D + FVector2D(Radius, Radius));
+
+	// Half a cell per sample, so no cell is stepped over
+	int32 NumSamples = FMath::Max(FMath::CeilToInt(Translation2D.Size() * InvCellSize * 2.0f), 1);
+
+	for (int32 Sample = 1; Sample <= NumSamples; ++Sample)
+	{
+		FVector2D Location = Start2D + Translation2D * ((float)Sample / NumSamples);
+		FIntPoint Min = GetCell(Location - FVector2D(Radius, Radius));
+		FIntPoint Max = GetCell(Location + FVector2D(Radius, Radius));
+
+		if (Min.X < 0 || Min.Y < 0 || Max.X >= SizeX || Max.Y >= SizeY) return EMoveResult::Unknown;
+
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			{
+				if (X >= StartMin.X && X <= StartMax.X && Y >= StartMin.Y && Y <= StartMax.Y) continue;
+
+				int32 Index = GetCellIndex(X, Y);
+				if (Flags[Index] & Dynamic) return EMoveResult::Unknown;
+				if (Flags[Index] & Empty) continue;
+
+				if (Heights[Index] > WallHeight)
+				{
+					OutTime = (float)(Sample - 1) / NumSamples;
+					return EMoveResult::Blocked;
+				}
+			}
+		}
+	}
+
+	return EMoveResult::Clear;
+}
@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartTuning.h"
+
+#include "PhysicsEngine/PhysicsSettings.h"
+
+void UGoKartTuning::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	UpdateParams();
+}
+
+void UGoKartTuning::PostLoad()
+{
+	Super::PostLoad();
+
+	UpdateParams();
+}
+
+#if WITH_EDITOR
+void UGoKartTuning::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	UpdateParams();
+}
+#endif
+
+void UGoKartTuning::UpdateParams()
+{
+	Params.Mass = Mass;
+	Params.MaxDrivingForce = MaxDrivingForce;
+	Params.MinTurningRadius = MinTurningRadius;
+	Params.DragCoef = DragCoef;
+	Params.RollingResistanceCoef = RollingResistanceCoef;
+	Params.GravityZ = UPhysicsSettings::Get()->DefaultGravityZ;
+	Params.UpdateDerived();
+}
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartDynamics.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// The per-kart FVector integration UGoKartMovementComp used before FGoKartDynamics
+	void StepReference(const FGoKartDynamicsParams& Params, FGoKartDynamicsKart& Kart)
+	{
+		FVector Force = Kart.Forward * Params.MaxDrivingForce * Kart.Throttle;
+		Force += -Kart.Velocity.GetSafeNormal() * Kart.Velocity.SizeSquared() * Params.DragCoef;
+		Force += -Kart.Velocity.GetSafeNormal() * Params.RollingResistanceCoef * Params.Mass * (-Params.GravityZ / 100.0f);
+		Kart.Velocity += Force / Params.Mass * Kart.DeltaTime;
+
+		float DeltaLocation = FVector::DotProduct(Kart.Forward, Kart.Velocity) * Kart.DeltaTime;
+		Kart.RotationAngle = DeltaLocation / Params.MinTurningRadius * Kart.SteeringThrow;
+		Kart.Velocity = FQuat(Kart.Up, Kart.RotationAngle).RotateVector(Kart.Velocity);
+
+		Kart.Translation = Kart.Velocity * 100 * Kart.DeltaTime;
+	}
+
+	FGoKartDynamicsKart MakeRandomKart(FRandomStream& Random)
+	{
+		FGoKartDynamicsKart Kart;
+		// Some karts at rest, to cover the zero speed guard
+		Kart.Velocity = Random.FRand() < 0.1f ? FVector::ZeroVector : Random.GetUnitVector() * Random.FRandRange(0.0f, 40.0f);
+		FQuat Rotation(Random.GetUnitVector(), Random.FRandRange(-PI, PI));
+		Kart.Forward = Rotation.GetForwardVector();
+		Kart.Up = Rotation.GetUpVector();
+		Kart.Throttle = Random.FRandRange(-1.0f, 1.0f);
+		Kart.SteeringThrow = Random.FRandRange(-1.0f, 1.0f);
+		Kart.DeltaTime = Random.FRandRange(0.001f, 0.1f);
+		return Kart;
+	}
+
+	bool IsNear(float Value, float Expected)
+	{
+		return FMath::Abs(Value - Expected) <= 1e-3f * FMath::Max(1.0f, FMath::Abs(Expected));
+	}
+
+	bool IsNear(const FVector& Value, const FVector& Expected)
+	{
+		return IsNear(Value.X, Expected.X) && IsNear(Value.Y, Expected.Y) && IsNear(Value.Z, Expected.Z);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGoKartDynamicsStepBatchTest, "KrazyKarts.Dynamics.StepBatch", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGoKartDynamicsStepBatchTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(1234);
+
+	FGoKartDynamicsParams Params;
+	Params.Mass = 800.0f;
+	Params.MaxDrivingForce = 12000.0f;
+	Params.MinTurningRadius = 8.0f;
+	Params.GravityZ = -1200.0f;
+	Params.UpdateDerived();
+
+	// Not a multiple of the lane count, so the padded tail is stepped too
+	const int32 NumKarts = 37;
+
+	TArray<FGoKartDynamicsKart> Karts;
+	FGoKartDynamicsBatch Batch;
+	Batch.Reset(NumKarts);
+	for (int32 Index = 0; Index < NumKarts; ++Index)
+	{
+		Karts.Add(MakeRandomKart(Random));
+		Batch.SetKart(Index, Karts[Index]);
+	}
+
+	FGoKartDynamics::StepBatch(Params, Batch);
+
+	for (int32 Index = 0; Index < NumKarts; ++Index)
+	{
+		FGoKartDynamicsKart Batched = Karts[Index];
+		Batch.GetKart(Index, Batched);
+
+		FGoKartDynamicsKart Reference = Karts[Index];
+		StepReference(Params, Reference);
+
+		TestTrue(FString::Printf(TEXT("Kart %d velocity matches the reference"), Index), IsNear(Batched.Velocity, Reference.Velocity));
+		TestTrue(FString::Printf(TEXT("Kart %d rotation matches the reference"), Index), IsNear(Batched.RotationAngle, Reference.RotationAngle));
+		TestTrue(FString::Printf(TEXT("Kart %d translation matches the reference"), Index), IsNear(Batched.Translation, Reference.Translation));
+
+		// The manager batches each machine's locally created moves, while the server simulates received client
+		// moves and replays one at a time, so these have to agree exactly
+		FGoKartDynamicsKart Single = Karts[Index];
+		FGoKartDynamics::Step(Params, Single);
+
+		TestTrue(FString::Printf(TEXT("Kart %d single step matches the batch exactly"), Index),
+			Single.Velocity == Batched.Velocity && Single.RotationAngle == Batched.RotationAngle && Single.Translation == Batched.Translation);
+	}
+
+	return true;
+}
+
+#endif
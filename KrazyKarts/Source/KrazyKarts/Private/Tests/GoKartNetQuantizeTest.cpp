@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartNetQuantize.h"
+
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// Writes Value and reads it back, as the server and a client would
+	FQuat RoundTripRotation(const FQuat& Value, int32& OutBits)
+	{
+		FBitWriter Writer(0, true);
+		FQuat Saved = Value;
+		FGoKartNetQuantize::SerializeRotation(Writer, Saved);
+		OutBits = (int32)Writer.GetNumBits();
+
+		FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+		FQuat Loaded = FQuat::Identity;
+		FGoKartNetQuantize::SerializeRotation(Reader, Loaded);
+		return Loaded;
+	}
+
+	float GetErrorDegrees(const FQuat& A, const FQuat& B)
+	{
+		return FMath::RadiansToDegrees(A.AngularDistance(B));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGoKartNetQuantizeRotationTest, "KrazyKarts.Net.QuantizeRotation", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGoKartNetQuantizeRotationTest::RunTest(const FString& Parameters)
+{
+	// Half of the yaw only encoding's step, and comfortably above smallest-three's (degrees)
+	const float YawOnlyError = 0.5f * 360.0f / 65536.0f;
+	const float SmallestThreeError = 0.01f;
+
+	FRandomStream Random(0);
+
+	for (int32 Index = 0; Index < 64; ++Index)
+	{
+		float Yaw = Random.FRandRange(-180.0f, 180.0f);
+		int32 Bits;
+
+		// Upright karts, exactly and with the tilt float drift leaves behind, are sent as yaw only
+		FQuat Upright = FRotator(0.0f, Yaw, 0.0f).Quaternion();
+		FQuat Decoded = RoundTripRotation(Upright, Bits);
+		TestEqual(FString::Printf(TEXT("Upright kart %d is sent as yaw only"), Index), Bits, 17);
+		TestTrue(FString::Printf(TEXT("Upright kart %d round trips"), Index), GetErrorDegrees(Upright, Decoded) <= YawOnlyError + KINDA_SMALL_NUMBER);
+
+		FQuat Drifted = FRotator(0.01f, Yaw, -0.01f).Quaternion();
+		Decoded = RoundTripRotation(Drifted, Bits);
+		TestEqual(FString::Printf(TEXT("Nearly upright kart %d is sent as yaw only"), Index), Bits, 17);
+		TestTrue(FString::Printf(TEXT("Nearly upright kart %d only loses its tilt"), Index), GetErrorDegrees(Drifted, Decoded) <= 0.02f + YawOnlyError);
+
+		// Visibly tilted karts keep their tilt
+		float Pitch = Random.FRandRange(1.0f, 45.0f) * (Random.FRand() < 0.5f ? -1.0f : 1.0f);
+		float Roll = Random.FRandRange(-45.0f, 45.0f);
+		FQuat Tilted = FRotator(Pitch, Yaw, Roll).Quaternion();
+		Decoded = RoundTripRotation(Tilted, Bits);
+		TestEqual(FString::Printf(TEXT("Tilted kart %d is sent as smallest-three"), Index), Bits, 48);
+		TestTrue(FString::Printf(TEXT("Tilted kart %d round trips"), Index), GetErrorDegrees(Tilted, Decoded) <= SmallestThreeError);
+
+		// q and -q are the same rotation, and must decode as such
+		Decoded = RoundTripRotation(Tilted * -1.0f, Bits);
+		TestTrue(FString::Printf(TEXT("Negated tilted kart %d round trips"), Index), GetErrorDegrees(Tilted, Decoded) <= SmallestThreeError);
+	}
+
+	return true;
+}
+
+#endif
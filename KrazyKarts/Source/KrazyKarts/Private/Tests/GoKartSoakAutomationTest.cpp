@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSoakTest.h"
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// The world of the running game, which is connected as a server or a client for a soak test
+	UWorld* FindGameWorld()
+	{
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			if ((Context.WorldType == EWorldType::Game || Context.WorldType == EWorldType::PIE) && Context.World() != nullptr) return Context.World();
+		}
+		return nullptr;
+	}
+
+	// Waits for this process's soak test in World to finish, then reports each threshold it failed as an error
+	class FWaitForSoakTestCommand : public IAutomationLatentCommand
+	{
+	public:
+		FWaitForSoakTestCommand(FAutomationTestBase* InTest, UWorld* InWorld, float InTimeout)
+			: Test(InTest)
+			, World(InWorld)
+			, Timeout(InTimeout)
+			, bFinished(false)
+		{
+			FinishedHandle = AGoKartSoakTest::OnFinished.AddRaw(this, &FWaitForSoakTestCommand::OnFinished);
+		};
+
+		virtual ~FWaitForSoakTestCommand()
+		{
+			AGoKartSoakTest::OnFinished.Remove(FinishedHandle);
+		};
+
+		virtual bool Update() override
+		{
+			if (bFinished)
+			{
+				for (const FString& Failure : Failures) Test->AddError(Failure);
+				return true;
+			}
+
+			if (!World.IsValid())
+			{
+				Test->AddError(TEXT("The world went away before the soak test finished."));
+				return true;
+			}
+
+			if (GetCurrentRunTime() > Timeout)
+			{
+				Test->AddError(FString::Printf(TEXT("The soak test did not finish within %.0fs."), Timeout));
+				return true;
+			}
+
+			return false;
+		};
+
+	private:
+		FAutomationTestBase* Test;
+
+		TWeakObjectPtr<UWorld> World;
+
+		float Timeout;
+
+		bool bFinished;
+
+		TArray<FString> Failures;
+
+		FDelegateHandle FinishedHandle;
+
+		void OnFinished(UWorld* FinishedWorld, const TArray<FString>& InFailures)
+		{
+			if (FinishedWorld != World.Get()) return;
+
+			Failures = InFailures;
+			bFinished = true;
+		};
+	};
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FGoKartSoakAutomationTest, "KrazyKarts.Net.Soak", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::StressFilter)
+
+void FGoKartSoakAutomationTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	// kart.Soak.Start arguments: Duration MinClients PktLagMs PktLagVarianceMs PktLossPercent
+	OutBeautifiedNames.Add(TEXT("Default"));
+	OutTestCommands.Add(TEXT("300 1 100 20 1"));
+
+	OutBeautifiedNames.Add(TEXT("HighLatency"));
+	OutTestCommands.Add(TEXT("300 1 250 50 3"));
+}
+
+bool FGoKartSoakAutomationTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = FindGameWorld();
+	if (World == nullptr || World->GetNetMode() == NM_Standalone)
+	{
+		AddError(TEXT("The soak test needs a listen server, dedicated server or client game world."));
+		return false;
+	}
+
+	TArray<FString> Args;
+	Parameters.ParseIntoArrayWS(Args);
+
+	// Clients run the test the server replicates to them, with the server's settings
+	if (World->GetNetMode() != NM_Client && AGoKartSoakTest::Start(World, Args) == nullptr)
+	{
+		AddError(TEXT("Could not start the soak test."));
+		return false;
+	}
+
+	// On top of the run itself, allow for the clients to connect
+	const float ConnectTime = 600.0f;
+	float Duration = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 300.0f;
+
+	ADD_LATENT_AUTOMATION_COMMAND(FWaitForSoakTestCommand(this, World, Duration + ConnectTime));
+	return true;
+}
+
+#endif
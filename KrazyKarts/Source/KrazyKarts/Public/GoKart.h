@@ -8,6 +8,8 @@
 #include "GoKartMovementReplicator.h"
 #include "GoKart.generated.h"
 
+class AGoKartManager;
+
 UCLASS()
 class KRAZYKARTS_API AGoKart : public APawn
 {
@@ -21,13 +23,23 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
+public:	
 	// Called to bind functionality to input
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
+	// Both make sure the kart manager ticks after the new controller's input
+	virtual void PossessedBy(AController* NewController) override;
+
+	virtual void OnRep_Controller() override;
+
+	// Defers to the kart manager's relevancy grid when it is active
+	virtual bool IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const override;
+
+	// Scales priority by how active the kart is and how close it is to the viewer
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, class APlayerController* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+
 private:
 	UPROPERTY(VisibleAnywhere)
 	UGoKartMovementComp* MovementComp;
@@ -35,6 +47,9 @@ private:
 	UPROPERTY(VisibleAnywhere)
 	UGoKartMovementReplicator* MovementReplicator;
 
+	UPROPERTY(Transient)
+	AGoKartManager* Manager;
+
 	void MoveForward(float Value);
 
 	void MoveRight(float Value);
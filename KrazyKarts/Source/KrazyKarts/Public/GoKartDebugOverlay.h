@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Per-kart network diagnostics drawn over each kart. Compiled out of shipping and dedicated server builds.
+#define GOKART_DEBUG_OVERLAY (!UE_BUILD_SHIPPING && !UE_SERVER)
+
+#if GOKART_DEBUG_OVERLAY
+
+class AGoKart;
+class APlayerController;
+class UCanvas;
+
+// Draws role, unacknowledged moves, last correction and update interval above every kart while
+// kart.Debug.Overlay is set. Text is formatted into a stack buffer, so nothing is allocated per frame.
+struct KRAZYKARTS_API FGoKartDebugOverlay
+{
+	static bool IsEnabled();
+
+	static void Draw(UCanvas* Canvas, APlayerController* PlayerController, const TArray<AGoKart*>& Karts);
+};
+
+#endif
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Kart force/drag/rolling-resistance/rotation integration, free of any actor or world access.
+// Only depends on Core so it can be stepped, profiled and tested without an engine instance.
+
+// Constants shared by every kart stepped together (kg, N, m, m/s). Call UpdateDerived after changing any of them.
+struct KRAZYKARTS_API FGoKartDynamicsParams
+{
+	// The Mass of the car (kg). 1000kg = 1ton
+	float Mass = 1000.0f;
+
+	// The force applied to the car when the throttle is fully down (N)
+	float MaxDrivingForce = 10000.0f;
+
+	// Minimum radius of the car turning circle at full lock (m)
+	float MinTurningRadius = 10.0f;
+
+	// Higher means more drag.
+	float DragCoef = 16.0f;
+
+	// Higher means more Rolling Resistance.
+	float RollingResistanceCoef = 0.015f;
+
+	// World gravity (cm/s^2), as returned by UWorld::GetGravityZ
+	float GravityZ = -980.0f;
+
+	// Derived from the above by UpdateDerived, so stepping a kart does no divisions
+	float InvMass = 1.0f / 1000.0f;
+
+	// MaxDrivingForce / Mass (m/s^2)
+	float DrivingAcceleration = 10.0f;
+
+	// Crr * N, where N = m * g and g is converted from cm/s^2 to m/s^2 (N)
+	float RollingForce = 0.015f * 1000.0f * 9.8f;
+
+	float InvTurningRadius = 1.0f / 10.0f;
+
+	void UpdateDerived()
+	{
+		InvMass = 1.0f / Mass;
+		DrivingAcceleration = MaxDrivingForce * InvMass;
+		RollingForce = RollingResistanceCoef * Mass * (-GravityZ / 100.0f);
+		InvTurningRadius = 1.0f / MinTurningRadius;
+	};
+
+	// Derived constants follow from the rest, so are not compared
+	bool operator==(const FGoKartDynamicsParams& Other) const
+	{
+		return Mass == Other.Mass && MaxDrivingForce == Other.MaxDrivingForce && MinTurningRadius == Other.MinTurningRadius
+			&& DragCoef == Other.DragCoef && RollingResistanceCoef == Other.RollingResistanceCoef && GravityZ == Other.GravityZ;
+	};
+};
+
+// One kart's input to, and result of, a single step
+struct FGoKartDynamicsKart
+{
+	// In: current velocity (m/s). Out: velocity after the step
+	FVector Velocity = FVector::ZeroVector;
+
+	// Actor forward and up vectors at the start of the step
+	FVector Forward = FVector::ForwardVector;
+	FVector Up = FVector::UpVector;
+
+	float Throttle = 0.0f;
+	float SteeringThrow = 0.0f;
+	float DeltaTime = 0.0f;
+
+	// Out: rotation to apply around Up (radians)
+	float RotationAngle = 0.0f;
+
+	// Out: world offset to apply (cm)
+	FVector Translation = FVector::ZeroVector;
+};
+
+// Structure-of-arrays state for N karts. Streams are padded to a multiple of the SIMD width with idle karts.
+struct KRAZYKARTS_API FGoKartDynamicsBatch
+{
+	enum EStream
+	{
+		VelocityX, VelocityY, VelocityZ,
+		ForwardX, ForwardY, ForwardZ,
+		UpX, UpY, UpZ,
+		Throttle, SteeringThrow, DeltaTime,
+		RotationAngle,
+		TranslationX, TranslationY, TranslationZ,
+		NumStreams
+	};
+
+	static const int32 LaneCount = 4;
+
+	// Resizes every stream to hold InNum karts, all idle
+	void Reset(int32 InNum);
+
+	int32 Num() const { return NumKarts; };
+
+	void SetKart(int32 Index, const FGoKartDynamicsKart& Kart);
+
+	void GetKart(int32 Index, FGoKartDynamicsKart& OutKart) const;
+
+	float* GetStream(EStream Stream) { return Streams[Stream].GetData(); };
+
+	const float* GetStream(EStream Stream) const { return Streams[Stream].GetData(); };
+
+private:
+	TArray<float> Streams[NumStreams];
+
+	int32 NumKarts = 0;
+};
+
+struct KRAZYKARTS_API FGoKartDynamics
+{
+	// Steps every kart in the batch by its own DeltaTime
+	static void StepBatch(const FGoKartDynamicsParams& Params, FGoKartDynamicsBatch& Batch);
+
+	// Steps karts [Start, Start + Count) only. Start must be a multiple of FGoKartDynamicsBatch::LaneCount.
+	static void StepRange(const FGoKartDynamicsParams& Params, FGoKartDynamicsBatch& Batch, int32 Start, int32 Count);
+
+	// Steps a single kart. Runs the same vector kernel as StepBatch so results match bit for bit.
+	static void Step(const FGoKartDynamicsParams& Params, FGoKartDynamicsKart& Kart);
+};
@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GoKartMovementComp.h"
+#include "GoKartLoadTest.generated.h"
+
+class UGoKartMovementReplicator;
+
+// Spawns bot karts on the server that upload moves through UGoKartMovementReplicator exactly like a
+// batching client, minus the socket. Writes server frame time percentiles and move RPCs/s to CSV once a
+// second. Bots have no connection, so bandwidth is left to kart.Soak.Start with real clients. Needs no GPU,
+// start it with "kart.LoadTest.Start".
+UCLASS(NotPlaceable, Transient)
+class KRAZYKARTS_API AGoKartLoadTest : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AGoKartLoadTest();
+
+	// bRandomInput drives bots with random throttle and steering, otherwise every bot follows the same weave
+	void StartTest(int32 NumKarts, float Duration, bool bRandomInput, const FString& CsvPath);
+
+	virtual void Tick(float DeltaTime) override;
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	struct FBot
+	{
+		TWeakObjectPtr<AActor> Kart;
+
+		UGoKartMovementReplicator* Replicator;
+
+		FRandomStream Random;
+
+		float Throttle;
+
+		float SteeringThrow;
+
+		float NextInputChangeTime;
+
+		// Client side clock and fixed step state, as a 60 Hz client would have
+		float ClientTime;
+
+		float StepAccumulator;
+
+		float SendAccumulator;
+
+		uint32 NextSequence;
+
+		TArray<FGoKartMove> PendingMoves;
+	};
+
+	TArray<FBot> Bots;
+
+	bool bRandomInput;
+
+	float TestDuration;
+
+	float TestTime;
+
+	FString CsvPath;
+
+	TArray<FString> CsvLines;
+
+	// Whole engine frames, including net driver dispatch and flush, not just world ticks
+	FDelegateHandle BeginFrameHandle;
+
+	FDelegateHandle EndFrameHandle;
+
+	double FrameStartTime;
+
+	// Frame times (ms) since the last CSV row
+	TArray<float> FrameTimes;
+
+	float TimeSinceRow;
+
+	uint32 LastPacketsReceived;
+
+	uint32 LastMovesReceived;
+
+	void BeginFrame();
+
+	void EndFrame();
+
+	void SpawnBots(int32 NumKarts);
+
+	void DriveBot(FBot& Bot, float DeltaTime);
+
+	void WriteRow();
+
+	void FinishTest();
+};
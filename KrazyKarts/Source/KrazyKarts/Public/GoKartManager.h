@@ -0,0 +1,211 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "GameFramework/Info.h"
+#include "GoKartRelevancyGrid.h"
+#include "GoKartTrackCollision.h"
+#include "GoKartDynamics.h"
+#include "GoKartServerSimulation.h"
+#include "GoKartDebugOverlay.h"
+#include "GoKartProxySmoothing.h"
+#include "GoKartManager.generated.h"
+
+class AController;
+class AGoKart;
+class AGoKartRacingLine;
+class UGoKartMovementComp;
+class UGoKartMovementReplicator;
+
+// Steps every registered kart's movement and replication in TG_PrePhysics, after player input
+USTRUCT()
+struct FGoKartManagerSimulationTick : public FTickFunction
+{
+	GENERATED_USTRUCT_BODY()
+
+	class AGoKartManager* Target;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FGoKartManagerSimulationTick> : public TStructOpsTypeTraitsBase2<FGoKartManagerSimulationTick>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+// One per world. Karts register with it, and it runs the work that is cheaper done for all karts at once.
+UCLASS(NotPlaceable, Transient)
+class KRAZYKARTS_API AGoKartManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AGoKartManager();
+
+	// Finds the manager of World, spawning it on first use
+	static AGoKartManager* Get(UWorld* World);
+
+	void RegisterKart(AGoKart* Kart);
+
+	void UnregisterKart(AGoKart* Kart);
+
+	// Runs the batched tick after Controller has processed input, when it is a local player's. Call whenever a
+	// kart is possessed, so late joining, travelling and split screen players are covered.
+	void AddInputPrerequisite(AController* Controller);
+
+	const TArray<AGoKart*>& GetKarts() const { return Karts; };
+
+	// Server only. False when Viewer's connection should not receive Kart at all.
+	bool IsKartRelevantTo(const AActor* Kart, const AActor* Viewer) const { return !bRelevancyGridActive || RelevancyGrid.IsRelevant(Kart, Viewer); };
+
+	// Server only. False when Kart is relevant to Viewer but not one of the nearest it receives at full rate.
+	bool IsKartFullRateFor(const AActor* Kart, const AActor* Viewer) const { return !bRelevancyGridActive || RelevancyGrid.IsFullRate(Kart, Viewer); };
+
+	bool IsRelevancyGridActive() const { return bRelevancyGridActive; };
+
+	// Server only. Most karts any connection receiving Kart receives, for sharing a connection's bandwidth.
+	// Every kart when the relevancy grid is off.
+	int32 GetRelevantKartCount(const AActor* Kart) const;
+
+	// Null on clients, and unless kart.Collision.TrackGrid is on
+	const FGoKartTrackCollision* GetTrackCollision() const { return TrackCollision.IsBaked() ? &TrackCollision : nullptr; };
+
+	// True when a kart other than Kart is within Distance of Location. Uses the relevancy grid when it is
+	// active, which holds kart locations from the end of the last frame.
+	bool IsNearOtherKart(const AActor* Kart, const FVector& Location, float Distance) const;
+
+	// Server only. Bakes the static collision of the whole level into the track grid, replacing any previous bake.
+	void BakeTrackCollision();
+
+	// Server only. Spawns Count karts on the racing line's starting grid, driven by the manager.
+	void SpawnBots(int32 Count);
+
+	void DestroyBots();
+
+	int32 GetNumBots() const { return Bots.Num(); };
+
+	virtual void Tick(float DeltaTime) override;
+
+	// Runs TickMovement then TickReplication for every kart, in place of their component ticks
+	void TickSimulation(float DeltaTime);
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void RegisterActorTickFunctions(bool bRegister) override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// What the batched tick needs of a kart, packed together so the pass does not chase actor pointers
+	struct FSimulatedKart
+	{
+		AGoKart* Kart;
+
+		UGoKartMovementComp* MovementComp;
+
+		UGoKartMovementReplicator* Replicator;
+
+		ENetRole Role;
+
+		ENetRole RemoteRole;
+	};
+
+	// A kart's own move this frame, stepped with every other kart sharing its dynamics params
+	struct FBatchedMove
+	{
+		const FGoKartDynamicsParams* Params;
+
+		FGoKartDynamicsKart Kart;
+
+		bool bStepped;
+	};
+
+	// A server-driven kart following the racing line
+	struct FBot
+	{
+		AGoKart* Kart;
+
+		UGoKartMovementComp* MovementComp;
+
+		// Along the racing line, last frame (cm)
+		float Distance;
+
+		// Fraction of the line's target speed this bot drives at, so bots spread out
+		float SpeedScale;
+	};
+
+	UPROPERTY()
+	TArray<AGoKart*> Karts;
+
+	TArray<FBot> Bots;
+
+	UPROPERTY()
+	AGoKartRacingLine* RacingLine;
+
+	TArray<FSimulatedKart> SimulatedKarts;
+
+	// Reused every frame. Each SimulatedKarts entry's index into BatchedMoves, or INDEX_NONE when it ticks alone.
+	TArray<FBatchedMove> BatchedMoves;
+
+	TArray<int32> KartBatchedMoves;
+
+	TArray<int32> DynamicsBatchMoves;
+
+	FGoKartDynamicsBatch DynamicsBatch;
+
+	// Reused every frame, with the SimulatedKarts index of each job's kart
+	TArray<FGoKartServerSimJob> ServerSimJobs;
+
+	TArray<int32> ServerSimJobKarts;
+
+	TArray<FVector> ServerSimKartLocations;
+
+	// Simulated proxies smoothing along a spline or between snapshots this frame, reused every frame
+	FGoKartProxySmoothingBatch ProxySmoothing;
+
+	FGoKartManagerSimulationTick SimulationTick;
+
+	bool bBatchedTick;
+
+#if GOKART_DEBUG_OVERLAY
+	FDelegateHandle DebugOverlayHandle;
+
+	void DrawDebugOverlay(UCanvas* Canvas, APlayerController* PlayerController);
+#endif
+
+	FGoKartRelevancyGrid RelevancyGrid;
+
+	FGoKartTrackCollision TrackCollision;
+
+	bool bRelevancyGridActive;
+
+	float TimeSinceFullRateRefresh;
+
+	void UpdateRelevancy(float DeltaTime);
+
+	// Steers every bot toward the racing line and sets its throttle, before any kart moves
+	void UpdateBots(float DeltaTime);
+
+	// Hands kart ticks to the simulation tick or back to the components when kart.Manager.BatchedTick changes
+	void UpdateBatchedTick();
+
+	void SetComponentTicksEnabled(const FSimulatedKart& SimulatedKart, bool bEnabled);
+
+	// Steps BatchedMoves through FGoKartDynamics::StepBatch, one batch per distinct dynamics params
+	void StepBatchedMoves();
+
+	bool IsParallelServerSimulationActive() const;
+
+	// Takes every authority kart's due client moves, simulates them across worker threads, then writes the
+	// results back in registration order
+	void SimulateServerMovesInParallel(float DeltaTime);
+};
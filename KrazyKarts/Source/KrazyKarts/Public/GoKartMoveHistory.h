@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartMovementComp.h"
+
+// Fixed capacity ring of moves with increasing sequence numbers, oldest first. Never allocates after
+// construction. Acknowledging by sequence is constant time while sequences are consecutive, which is
+// always the case for the moves an owning client creates.
+class KRAZYKARTS_API FGoKartMoveHistory
+{
+public:
+	// Must be a power of two
+	static const int32 Capacity = 128;
+
+	// Appends a move newer than the newest one. When full, the oldest move is
+	// dropped to make room, the overflow is counted and false is returned.
+	bool Add(const FGoKartMove& Move);
+
+	// Drops every move with a sequence up to and including Sequence
+	void AcknowledgeThrough(uint32 Sequence);
+
+	// Removes and returns the oldest move, for use as a FIFO queue
+	FGoKartMove PopOldest();
+
+	void Reset();
+
+	int32 Num() const { return Count; };
+
+	bool IsEmpty() const { return Count == 0; };
+
+	// Index 0 is the oldest move
+	const FGoKartMove& operator[](int32 Index) const
+	{
+		check(Index >= 0 && Index < Count);
+		return Moves[(Head + Index) & (Capacity - 1)];
+	};
+
+	// Moves dropped because the history was full
+	uint32 GetOverflowCount() const { return OverflowCount; };
+
+private:
+	FGoKartMove Moves[Capacity];
+
+	int32 Head = 0;
+
+	int32 Count = 0;
+
+	uint32 OverflowCount = 0;
+};
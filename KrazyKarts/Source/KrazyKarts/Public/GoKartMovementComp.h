@@ -4,8 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "GoKartDynamics.h"
 #include "GoKartMovementComp.generated.h"
 
+class AGoKartManager;
+class UGoKartTuning;
+
 USTRUCT()
 struct FGoKartMove
 {
@@ -23,7 +27,23 @@ struct FGoKartMove
 	UPROPERTY()
 		float Time;
 
-	bool IsValidMove() const { return FMath::Abs(Throttle) <= 1.0f && FMath::Abs(SteeringThrow) <= 1; };
+	// Monotonically increasing per kart, starting at 1. Moves are acknowledged by sequence, not Time.
+	UPROPERTY()
+		uint32 Sequence;
+
+	bool IsValidMove() const { return FMath::Abs(Throttle) <= 1.0f && FMath::Abs(SteeringThrow) <= 1 && DeltaTime >= 0.0f && FMath::IsFinite(DeltaTime); };
+};
+
+// Kart state right after a move was simulated
+struct FGoKartPredictedState
+{
+	uint32 Sequence = 0;
+
+	FVector Location = FVector::ZeroVector;
+
+	FQuat Rotation = FQuat::Identity;
+
+	FVector Velocity = FVector::ZeroVector;
 };
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
@@ -39,13 +59,27 @@ protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:	
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
-	void SimulateMove(const FGoKartMove& Move);
+	// The body of TickComponent, also run by AGoKartManager when it ticks every kart in one pass
+	void TickMovement(float DeltaTime, ENetRole Role, ENetRole RemoteRole);
+
+	// Without bSweep the kart is moved without collision, for callers that resolve it themselves
+	void SimulateMove(const FGoKartMove& Move, bool bSweep = true);
+
+	// Alternative to TickMovement for AGoKartManager, which steps many karts' dynamics in one FGoKartDynamics batch.
+	// When this tick would simulate exactly one move of our own, creates it, fills OutKart for the batch and returns
+	// true. FinishBatchedMove must then be called with the stepped kart in place of TickMovement.
+	bool PrepareBatchedMove(float DeltaTime, ENetRole Role, ENetRole RemoteRole, FGoKartDynamicsKart& OutKart);
 
-	FVector GetVelocity() { return Velocity; };
+	// Moves the kart by a step of the move from PrepareBatchedMove, and records it for the replicator
+	void FinishBatchedMove(const FGoKartDynamicsKart& Kart);
+
+	FVector GetVelocity() const { return Velocity; };
 
 	void SetVelocity(FVector Val) { Velocity = Val; };
 
@@ -53,31 +87,92 @@ public:
 
 	void SetSteeringThrow(float Val) { SteeringThrow = Val; };
 
+	// Stops the component creating moves from its own throttle and steering, for karts whose moves are made elsewhere
+	void SetExternalMoveSource(bool bExternal) { bExternalMoveSource = bExternal; };
+
+	// Server only. How far in the past the owning client saw other karts. Sweeps that hit a kart the client had not
+	// reached where it saw it carry on through that kart. 0 resolves contacts against current positions.
+	void SetContactRewindTime(float Time) { ContactRewindTime = Time; };
+
+	float GetContactRewindTime() const { return ContactRewindTime; };
+
 	FGoKartMove GetLastMove() { return LastMove; };
 
+	// Moves created and simulated during this frame's tick. Empty when a fixed step did not elapse.
+	const TArray<FGoKartMove>& GetNewMoves() const { return NewMoves; };
+
+	// The state each of GetNewMoves left the kart in, in the same order
+	const TArray<FGoKartPredictedState>& GetNewMoveStates() const { return NewMoveStates; };
+
+	bool IsUsingFixedTimestep() const { return bUseFixedTimestep; };
+
+	// Fraction of a fixed step left in the accumulator, for render interpolation
+	float GetFixedStepAlpha() const { return StepAccumulator * FixedStepRate; };
+
+	// Actor transform before the most recent fixed step
+	const FTransform& GetPreviousStepTransform() const { return PreviousStepTransform; };
+
+	// Stops blending from the previous fixed step, e.g. after the actor was corrected
+	void ResetStepInterpolation() { PreviousStepTransform = GetOwner()->GetActorTransform(); };
+
+	// True when moves can be resolved against the baked track grid instead of physics sweeps
+	bool IsTrackCollisionAvailable() const;
+
+	float GetTrackCollisionRadius() const { return TrackCollisionRadius; };
+
+	// Tuning's params for FGoKartDynamics, or a copy with the world's gravity where that is not the default.
+	// World gravity is read at BeginPlay and when the tuning changes.
+	const FGoKartDynamicsParams& GetDynamicsParams() const;
+
+	// Tuning, or the defaults of UGoKartTuning when none is set
+	const UGoKartTuning* GetTuning() const;
+
+	void SetTuning(UGoKartTuning* InTuning);
+
 private:
-	// The Mass of the car (kg). 1000kg = 1ton
+	// Handling shared with every kart using the same asset
 	UPROPERTY(EditAnywhere)
-	float Mass = 1000.0f;
+	UGoKartTuning* Tuning;
 
-	// The force applied to the car when the throttle is fully down (N)
+	// Create moves at FixedStepRate instead of once per frame. Caps the move and RPC rate regardless of frame rate.
 	UPROPERTY(EditAnywhere)
-	float MaxDrivingForce = 10000.0f;
+	bool bUseFixedTimestep = false;
 
-	// Minimum radius of the car turning circle at full lock (m)
-	UPROPERTY(EditAnywhere)
-	float MinTurningRadius = 10.0f;
+	// Moves per second when using a fixed timestep (Hz)
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseFixedTimestep", ClampMin = "1"))
+	float FixedStepRate = 60.0f;
 
-	// Higher means more drag. 
-	UPROPERTY(EditAnywhere)
-	float DragCoef = 16.0f;
+	// Steps allowed per frame before remaining time is dropped, so a long hitch can not spiral
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseFixedTimestep", ClampMin = "1"))
+	int32 MaxStepsPerFrame = 4;
 
-	// Higher means more Rolling Resistance.
-	UPROPERTY(EditAnywhere)
-	float RollingResistanceCoef = 0.015;
+	UPROPERTY(Transient)
+	AGoKartManager* Manager;
+
+	// Only used when the world overrides gravity
+	FGoKartDynamicsParams WorldGravityParams;
+
+	bool bWorldGravityOverride;
+
+	// Half width of the kart's collision, for the track grid (cm)
+	float TrackCollisionRadius;
+
+	float ContactRewindTime;
 
 	FGoKartMove LastMove;
 
+	TArray<FGoKartMove> NewMoves;
+
+	TArray<FGoKartPredictedState> NewMoveStates;
+
+	uint32 NextMoveSequence = 1;
+
+	bool bExternalMoveSource;
+
+	float StepAccumulator;
+
+	FTransform PreviousStepTransform;
+
 	FVector Velocity;
 
 	float Throttle;
@@ -86,12 +181,29 @@ private:
 
 	FGoKartMove CreateMove(float DeltaTime);
 
-	FVector GetAirResistance();
+	void TickFixedStep(float DeltaTime);
+
+	// Simulates a move created this frame and records it for the replicator
+	void SimulateNewMove(const FGoKartMove& Move);
+
+	void RecordNewMove(const FGoKartMove& Move);
+
+	// The kart's current state and Move's inputs, ready to step
+	void MakeDynamicsKart(const FGoKartMove& Move, FGoKartDynamicsKart& OutKart) const;
+
+	// Applies a stepped kart's velocity, rotation and translation
+	void ApplyDynamicsStep(const FGoKartDynamicsKart& Kart, bool bSweep);
+
+	void UpdateDynamicsParams();
+
+	void ApplyRotation(const FVector& Axis, float RotationAngle);
 
-	FVector GetRollingResistance();
+	void UpdateLocationFromVelocity(const FVector& Translation, bool bSweep);
 
-	void ApplyRotation(float DeltaTime, float InSteeringThrow);
+	// Sweeps on from a kart contact the owning client could not have seen, through the kart, to Start + Translation
+	void SweepPastUnseenKart(const FVector& Start, const FVector& Translation, FHitResult& Hit);
 
-	void UpdateLocationFromVelocity(float DeltaTime);
+	// False when the track grid can not resolve the move and it needs a physics sweep
+	bool MoveWithTrackCollision(const FVector& Translation);
 	
 };
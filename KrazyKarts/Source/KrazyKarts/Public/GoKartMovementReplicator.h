@@ -5,6 +5,10 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "GoKartMovementComp.h"
+#include "GoKartMoveHistory.h"
+#include "GoKartSnapshotBuffer.h"
+#include "GoKartStateHistory.h"
+#include "GoKartProxySmoothing.h"
 #include "GoKartMovementReplicator.generated.h"
 
 USTRUCT()
@@ -20,14 +24,69 @@ struct FGoKartState
 
 	UPROPERTY()
 	FGoKartMove LastMove;
+
+	// Server world time the state was taken at
+	UPROPERTY()
+	float ServerTime;
+
+	// Quantized position, rotation and velocity with no scale. See FGoKartNetQuantize.
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FGoKartState> : public TStructOpsTypeTraitsBase2<FGoKartState>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+// Client side prediction and smoothing error, accumulated until taken with TakeErrorStats
+struct FGoKartNetErrorStats
+{
+	uint32 Corrections = 0;
+
+	// Distance between predicted and corrected location (cm)
+	float TotalCorrectionSize = 0.0f;
+
+	float MaxCorrectionSize = 0.0f;
+
+	uint32 ProxyUpdates = 0;
+
+	// Distance between where a simulated proxy was drawn and where the next update showed it really was (cm)
+	float TotalProxyError = 0.0f;
+
+	float MaxProxyError = 0.0f;
+
+	void Accumulate(const FGoKartNetErrorStats& Other)
+	{
+		Corrections += Other.Corrections;
+		TotalCorrectionSize += Other.TotalCorrectionSize;
+		MaxCorrectionSize = FMath::Max(MaxCorrectionSize, Other.MaxCorrectionSize);
+		ProxyUpdates += Other.ProxyUpdates;
+		TotalProxyError += Other.TotalProxyError;
+		MaxProxyError = FMath::Max(MaxProxyError, Other.MaxProxyError);
+	};
 };
 
+// Cubic Hermite spline between two kart states, kept as polynomial coefficients A t^3 + B t^2 + C t + D.
+// Built once per update, so each frame only evaluates it.
 struct FHermiteCubicSpline
 {
-	FVector TargetLocation, StartLocation, StartDerivative, TargetDerivative;
+	FVector A = FVector::ZeroVector, B = FVector::ZeroVector, C = FVector::ZeroVector, D = FVector::ZeroVector;
+
+	FHermiteCubicSpline() {};
 
-	FVector InterpolateLocation(float LerpRatio) const { return FMath::CubicInterp(StartLocation, StartDerivative, TargetLocation, TargetDerivative, LerpRatio); };
-	FVector InterpolateDerivative(float LerpRatio) const { return FMath::CubicInterpDerivative(StartLocation, StartDerivative, TargetLocation, TargetDerivative, LerpRatio); };
+	FHermiteCubicSpline(const FVector& StartLocation, const FVector& StartDerivative, const FVector& TargetLocation, const FVector& TargetDerivative)
+		: A(2 * StartLocation + StartDerivative - 2 * TargetLocation + TargetDerivative)
+		, B(-3 * StartLocation - 2 * StartDerivative + 3 * TargetLocation - TargetDerivative)
+		, C(StartDerivative)
+		, D(StartLocation)
+	{};
+
+	FVector InterpolateLocation(float LerpRatio) const { return ((A * LerpRatio + B) * LerpRatio + C) * LerpRatio + D; };
+	FVector InterpolateDerivative(float LerpRatio) const { return (3 * A * LerpRatio + 2 * B) * LerpRatio + C; };
 };
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
@@ -53,13 +112,206 @@ public:
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+	// The body of TickComponent, also run by AGoKartManager after every kart's TickMovement. With ProxyBatch, a
+	// simulated proxy smoothing along a spline, or interpolating between snapshots, adds itself to the batch
+	// instead of placing its mesh.
+	void TickReplication(float DeltaTime, ENetRole Role, ENetRole RemoteRole, FGoKartProxySmoothingBatch* ProxyBatch = nullptr);
+
+	// Places a simulated proxy's mesh and sets its velocity from the smoothing spline
+	void ApplyProxySmoothing(const FVector& Location, const FQuat& Rotation, const FVector& Velocity);
+
+	// Multiplier for the owner's net priority toward a viewer, from kart activity and distance
+	float GetNetPriorityScale(const FVector& ViewPos) const;
+
+	// Server only. Feeds moves through the same validation and queueing as a batched upload RPC, for
+	// server-side test clients that have no connection.
+	void ReceiveLoopbackMoves(const TArray<FGoKartMove>& Moves);
+
+	// Most moves one batched upload may carry. The server rejects bigger packets.
+	int32 GetMaxMovesPerPacket() const { return MaxMovesPerPacket; };
+
+	// Server only. While set, client moves due for simulation are held for TakeServerMoves instead of being
+	// simulated here, so AGoKartManager can simulate many karts in parallel.
+	void SetExternalServerSimulation(bool bExternal);
+
+	// Runs the server move queue for DeltaTime and returns the client moves due this frame, unsimulated
+	void TakeServerMoves(float DeltaTime, TArray<FGoKartMove>& OutMoves);
+
+	// Puts the kart in the state simulating the moves from TakeServerMoves left it in
+	void ApplyServerMoves(const FGoKartMove& LastMove, const FVector& Location, const FQuat& Rotation, const FVector& Velocity);
+
+	int32 GetNumUnacknowledgedMoves() const { return UnacknowledgedMoves.Num(); };
+
+	// Distance between predicted and server location of the last correction (cm)
+	float GetLastCorrectionSize() const { return LastCorrectionSize; };
+
+	uint32 GetCorrectionCount() const { return CorrectionCount; };
+
+	// Adds the error since the last call to OutStats and starts over
+	void TakeErrorStats(FGoKartNetErrorStats& OutStats);
+
+	// Server time between the last two states received, or the interval the server is aiming for (s)
+	float GetUpdateInterval() const;
+
+	// Upload RPCs and moves received by the server since the kart spawned
+	uint32 GetServerPacketsReceived() const { return ServerPacketsReceived; };
+
+	uint32 GetServerMovesReceived() const { return ServerMovesReceived; };
+
+	// Moves the time bank shortened or dropped, and moves merged into another by the rate limit
+	uint32 GetServerMovesClamped() const { return ServerMovesClamped; };
+
+	uint32 GetServerMovesDropped() const { return ServerMovesDropped; };
+
+	uint32 GetServerMovesMerged() const { return ServerMovesMerged; };
+
+	// Server only. The kart's recent server states, for rewinding contacts with it.
+	const FGoKartStateHistory& GetServerStateHistory() const { return ServerStateHistory; };
+
+	// Server only. How far behind the server the owning client sees other karts, up to MaxContactRewindTime (s).
+	// 0 for karts without a remote owner, or with kart.LagComp.KartContacts off.
+	float GetContactRewindTime() const;
+
 	
 private:
+	// Server raises or lowers the kart's update rate with speed, steering and dead reckoning error
+	UPROPERTY(EditAnywhere, Category = "NetRate")
+	bool bAdaptiveNetUpdateRate = true;
+
+	// Update rate bounds (Hz)
+	UPROPERTY(EditAnywhere, Category = "NetRate", meta = (EditCondition = "bAdaptiveNetUpdateRate", ClampMin = "0.1"))
+	float MinNetUpdateRate = 2.0f;
+
+	UPROPERTY(EditAnywhere, Category = "NetRate", meta = (EditCondition = "bAdaptiveNetUpdateRate", ClampMin = "0.1"))
+	float MaxNetUpdateRate = 30.0f;
+
+	// Speed (m/s) and dead reckoning error (cm) that each earn the full update rate on their own
+	UPROPERTY(EditAnywhere, Category = "NetRate", meta = (EditCondition = "bAdaptiveNetUpdateRate", ClampMin = "0.1"))
+	float FullRateSpeed = 20.0f;
+
+	UPROPERTY(EditAnywhere, Category = "NetRate", meta = (EditCondition = "bAdaptiveNetUpdateRate", ClampMin = "0.1"))
+	float FullRateError = 50.0f;
+
+	// Bytes per second each connection may spend on all karts together, shared evenly between the karts it receives
+	UPROPERTY(EditAnywhere, Category = "NetRate", meta = (EditCondition = "bAdaptiveNetUpdateRate", ClampMin = "1"))
+	float ConnectionBandwidthBudget = 16000.0f;
+
+	// Approximate cost of one kart update on the wire, including bunch overhead (bytes)
+	UPROPERTY(EditAnywhere, Category = "NetRate", meta = (EditCondition = "bAdaptiveNetUpdateRate", ClampMin = "1"))
+	float EstimatedUpdateBytes = 32.0f;
+
+	// Viewers closer than this get full priority, further ones fall off with distance (cm)
+	UPROPERTY(EditAnywhere, Category = "NetRate", meta = (ClampMin = "1"))
+	float FullPriorityDistance = 3000.0f;
+
+	// Upload unacknowledged moves in one unreliable RPC per send interval instead of a reliable RPC per move
+	UPROPERTY(EditAnywhere, Category = "Upload")
+	bool bBatchMoveUpload = false;
+
+	// Batched upload packets per second (Hz)
+	UPROPERTY(EditAnywhere, Category = "Upload", meta = (EditCondition = "bBatchMoveUpload", ClampMin = "1"))
+	float MoveSendRate = 30.0f;
+
+	// Moves in each packet. Moves made since the last packet are merged to fit, and any slots left resend older
+	// unacknowledged uploads. Uploads older than this are lost if every packet carrying them is.
+	UPROPERTY(EditAnywhere, Category = "Upload", meta = (EditCondition = "bBatchMoveUpload", ClampMin = "1"))
+	int32 MaxMovesPerPacket = 8;
+
+	// Server queues each client's moves and drains them at ServerSimRate instead of simulating inside the RPC
+	UPROPERTY(EditAnywhere, Category = "Server")
+	bool bQueueServerMoves = true;
+
+	// Server move queue drain steps per second (Hz)
+	UPROPERTY(EditAnywhere, Category = "Server", meta = (EditCondition = "bQueueServerMoves", ClampMin = "1"))
+	float ServerSimRate = 60.0f;
+
+	// Most client moves simulated in one server step
+	UPROPERTY(EditAnywhere, Category = "Server", meta = (EditCondition = "bQueueServerMoves", ClampMin = "1"))
+	int32 MaxMovesPerServerStep = 4;
+
+	// Bounds of the adaptive jitter buffer, in seconds of client moves held before draining
+	UPROPERTY(EditAnywhere, Category = "Server", meta = (EditCondition = "bQueueServerMoves", ClampMin = "0"))
+	float MinJitterBufferTime = 0.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Server", meta = (EditCondition = "bQueueServerMoves", ClampMin = "0"))
+	float MaxJitterBufferTime = 0.1f;
+
+	// Seconds of client movement the owning connection can bank while idle or lagging and then spend in one
+	// burst. Moves beyond the bank are shortened or dropped, so a client can not run ahead of server time.
+	UPROPERTY(EditAnywhere, Category = "Server", meta = (ClampMin = "0.01"))
+	float MaxMoveTimeBank = 0.5f;
+
+	// Most client moves per second the server simulates. Moves beyond it are merged into the next one.
+	UPROPERTY(EditAnywhere, Category = "Server", meta = (ClampMin = "1"))
+	float MaxMovesPerSecond = 150.0f;
+
+	// Moves a client can send above MaxMovesPerSecond in one burst before merging starts
+	UPROPERTY(EditAnywhere, Category = "Server", meta = (ClampMin = "1"))
+	float MaxMoveBurst = 16.0f;
+
+	// Client moves shorter than this are merged with the next one before being simulated (s)
+	UPROPERTY(EditAnywhere, Category = "Server", meta = (ClampMin = "0"))
+	float MinMoveDeltaTime = 0.004f;
+
+	// Most a contact with another kart is rewound toward where the owning client saw that kart (s)
+	UPROPERTY(EditAnywhere, Category = "Server", meta = (ClampMin = "0"))
+	float MaxContactRewindTime = 0.25f;
+
+	// Simulated proxies render from a buffer of timestamped server states, slightly in the past
+	UPROPERTY(EditAnywhere, Category = "Smoothing")
+	bool bUseSnapshotInterpolation = true;
+
+	// How far behind the newest server state simulated proxies render (s). Never less than 1.5 update intervals.
+	UPROPERTY(EditAnywhere, Category = "Smoothing", meta = (EditCondition = "bUseSnapshotInterpolation", ClampMin = "0"))
+	float InterpolationDelay = 0.1f;
+
+	// How long simulated proxies keep moving on their last velocity when updates are late (s)
+	UPROPERTY(EditAnywhere, Category = "Smoothing", meta = (EditCondition = "bUseSnapshotInterpolation", ClampMin = "0"))
+	float MaxExtrapolationTime = 0.25f;
+
+	// Corrections smaller than these leave the locally predicted kart alone (cm, degrees, m/s)
+	UPROPERTY(EditAnywhere, Category = "Reconciliation", meta = (ClampMin = "0"))
+	float ReconcileLocationTolerance = 2.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Reconciliation", meta = (ClampMin = "0"))
+	float ReconcileRotationTolerance = 0.5f;
+
+	UPROPERTY(EditAnywhere, Category = "Reconciliation", meta = (ClampMin = "0"))
+	float ReconcileVelocityTolerance = 0.05f;
+
+	// Time for the mesh to catch up with a corrected kart (s)
+	UPROPERTY(EditAnywhere, Category = "Reconciliation", meta = (ClampMin = "0.01"))
+	float CorrectionSmoothTime = 0.1f;
 
 	UPROPERTY(ReplicatedUsing = OnRep_ServerState)
 	FGoKartState ServerState;
 
-	TArray<FGoKartMove> UnacknowledgedMoves;
+	FGoKartMoveHistory UnacknowledgedMoves;
+
+	// Set once the history overflows, so the warning is logged once per stall
+	bool bUnacknowledgedMovesOverflowed;
+
+	// Predicted state after each unacknowledged move, indexed by sequence
+	FGoKartPredictedState PredictedStates[FGoKartMoveHistory::Capacity];
+
+	// Remaining offset of the mesh from the corrected kart, decaying to zero
+	FVector CorrectionLocationOffset;
+
+	FQuat CorrectionRotationOffset = FQuat::Identity;
+
+	bool bSmoothingCorrection;
+
+	// Distance between predicted and server location of the last correction (cm)
+	float LastCorrectionSize;
+
+	uint32 CorrectionCount;
+
+	FGoKartNetErrorStats ErrorStats;
+
+	// Server time of the last state received, and how long before it the previous one was taken
+	float ClientLastServerTime;
+
+	float ClientUpdateInterval;
 
 	float ClientTimeSinceUpdate;
 
@@ -67,9 +319,93 @@ private:
 
 	FTransform ClientStartTransform;
 
-	FVector ClientStartVelocity;
+	// From the mesh's state when the last update arrived to that update
+	FHermiteCubicSpline ClientSpline;
+
+	// Spline derivative to velocity (m/s)
+	float ClientInvDerivativeScale;
+
+	FGoKartSnapshotBuffer ClientSnapshots;
+
+	// Server time simulated proxies currently render at
+	float ClientRenderTime;
+
+	// Running average of server time between snapshots
+	float ClientSnapshotInterval;
+
+	float MoveSendAccumulator;
+
+	// Reused for every batched upload to avoid allocating per packet
+	TArray<FGoKartMove> MoveBatch;
+
+	// Unacknowledged moves as batched uploads send them, after merging
+	FGoKartMoveHistory UploadedMoves;
+
+	// Newest move merged into UploadedMoves. Moves are numbered from 1, so 0 is none.
+	uint32 ClientLastSentSequence;
+
+	// Newest move the server has received. Older and duplicate moves are dropped.
+	uint32 ServerLastMoveSequence;
+
+	FGoKartMoveHistory ServerMoveQueue;
+
+	bool bExternalServerSimulation;
+
+	// Moves due for simulation while bExternalServerSimulation is set
+	TArray<FGoKartMove> ServerPendingMoves;
+
+	uint32 ServerPacketsReceived;
+
+	uint32 ServerMovesReceived;
+
+	uint32 ServerMovesClamped;
+
+	uint32 ServerMovesDropped;
+
+	uint32 ServerMovesMerged;
+
+	// Client time the connection may still submit, refilled at server time rate up to MaxMoveTimeBank
+	float ServerMoveTimeBank;
+
+	// Moves the connection may still submit before merging, refilled at MaxMovesPerSecond up to MaxMoveBurst
+	float ServerMoveTokens;
 
-	float ClientSimulatedTime;
+	// Accepted moves waiting for a token or to reach MinMoveDeltaTime
+	FGoKartMove ServerMergedMove;
+
+	bool bServerHasMergedMove;
+
+	FGoKartStateHistory ServerStateHistory;
+
+	// Client time held in ServerMoveQueue
+	float ServerQueuedTime;
+
+	float ServerStepAccumulator;
+
+	// Client time the next server step may still consume
+	float ServerMoveBudget;
+
+	// False until the jitter buffer has filled, and again after it runs dry
+	bool bServerQueuePrimed;
+
+	// RFC 3550 style running estimate of move arrival jitter
+	float ServerArrivalJitter;
+
+	float ServerLastTransitTime;
+
+	float NetRateTimeSinceUpdate;
+
+	// Server only, for how many karts share each connection's bandwidth
+	UPROPERTY(Transient)
+	AGoKartManager* Manager;
+
+	// Kart state at the last rate update, to measure how far dead reckoning would drift
+	FVector NetRateLastLocation;
+
+	FVector NetRateLastVelocity;
+
+	// 0 when parked and steady, 1 when fast, turning hard or hard to predict
+	float NetActivity;
 
 	UFUNCTION(BlueprintCallable, Category = "MovementReplicator")
 	void SetMeshOffsetRoot(USceneComponent* Root) { MeshOffsetRoot = Root; };
@@ -81,24 +417,68 @@ private:
 
 	void AutonomousProxy_OnRep_ServerState();
 
-	void ClientTick(float DeltaTime);
+	// True when the server state matches what we predicted for the same move
+	bool IsPredictionCorrect() const;
+
+	// Replays unacknowledged moves without collision, then sweeps once from the server location to the result
+	void ReplayUnacknowledgedMoves();
+
+	// Overwrites the prediction for Sequence with the kart's current state, so later acks compare against it
+	void UpdatePredictedState(uint32 Sequence);
+
+	void ClientTick(float DeltaTime, FGoKartProxySmoothingBatch* ProxyBatch);
+
+	void SnapshotClientTick(float DeltaTime, FGoKartProxySmoothingBatch* ProxyBatch);
 
 	// Multiplied by 100 to go from CM to M
 	float VelocityToDerivative() { return ClientTimeBetweenLastUpdates * 100; };
 
-	FHermiteCubicSpline CreateSpline();
+	// Places the mesh of a kart that is not a simulated proxy. Where this machine steps the kart, blends between
+	// the last two fixed steps to hide the accumulator remainder. Eases out any correction offset. Elsewhere the
+	// mesh stays on the actor.
+	void UpdateLocalMesh(float DeltaTime, bool bLocallyStepped);
+
+	void UpdateServerState(const FGoKartMove& Move);
 
-	void InterpolateLocation(const FHermiteCubicSpline& Spline, float LerpRatio);
+	void ClearAcknowledgedMoves(const FGoKartMove& LastMove);
 
-	void InterpolateVelocity(const FHermiteCubicSpline& Spline, float LerpRatio);
+	void SendMoveBatch();
 
-	void InterpolateRotation(float LerpRatio);
+	// Queues or simulates a move received from the owning client unless it was already received
+	void ReceiveMove(const FGoKartMove& Move);
 
-	void UpdateServerState(const FGoKartMove& Move);
+	void SimulateClientMove(const FGoKartMove& Move);
+
+	void UpdateArrivalJitter(const FGoKartMove& Move);
+
+	float GetJitterBufferTime() const { return FMath::Clamp(2.0f * ServerArrivalJitter, MinJitterBufferTime, MaxJitterBufferTime); };
+
+	void TickServerMoveQueue(float DeltaTime);
+
+	void DrainServerMoveQueue(float StepTime);
 
-	void ClearAcknowledgedMoves(FGoKartMove LastMove);
+	void UpdateNetUpdateRate(float DeltaTime);
+
+	bool IsNewMove(const FGoKartMove& Move) const { return (int32)(Move.Sequence - ServerLastMoveSequence) > 0; };
+
+	bool IsMoveAcceptable(const FGoKartMove& Move) const;
+
+	// Refills the time bank and move tokens, and releases a held merged move once it may go
+	void TickMoveLimits(float DeltaTime);
+
+	// Spends Move's time from the bank, shortening it to what is left. False when the bank is empty.
+	bool SpendMoveTime(FGoKartMove& Move);
+
+	// Queues or simulates the held merged move if it is long enough and a token is free
+	void ReleaseMergedMove();
+
+	// Queues or simulates a move that passed the time bank and rate limit
+	void AcceptMove(const FGoKartMove& Move);
 
 	UFUNCTION(Server, Reliable, WithValidation)
 	void Server_SendMove(FGoKartMove Move);
+
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void Server_SendMoves(const TArray<FGoKartMove>& Moves);
 	
 };
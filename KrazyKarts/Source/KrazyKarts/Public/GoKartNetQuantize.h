@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Bit-packing helpers for kart replication. Every function is symmetric: it writes when Ar is saving
+// and overwrites Value with the decoded result when Ar is loading.
+struct KRAZYKARTS_API FGoKartNetQuantize
+{
+	// Grid size for replicated positions (cm), from kart.Net.PositionResolution
+	static float GetPositionResolution();
+
+	// Grid size for replicated velocities (m/s), from kart.Net.VelocityResolution
+	static float GetVelocityResolution();
+
+	// Each axis snapped to Resolution and written as a zigzag varint
+	static void SerializeVector(FArchive& Ar, FVector& Value, float Resolution);
+
+	// Yaw only (17 bits) when the kart is upright to within what the position grid resolves, otherwise
+	// smallest-three (48 bits)
+	static void SerializeRotation(FArchive& Ar, FQuat& Value);
+
+	// Value in [-1, 1] as one byte
+	static void SerializeUnitFloat(FArchive& Ar, float& Value);
+
+	static void SerializeSignedPacked(FArchive& Ar, int32& Value);
+};
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UGoKartMovementReplicator;
+struct FHermiteCubicSpline;
+
+// Every simulated proxy's spline smoothing for a frame, evaluated together. Splines are stored as
+// structure-of-arrays coefficients, padded to the SIMD width, so locations and velocities for four
+// karts come out of each pass. Results are written back to the karts afterwards, in one loop.
+class KRAZYKARTS_API FGoKartProxySmoothingBatch
+{
+public:
+	enum EStream
+	{
+		AX, AY, AZ,
+		BX, BY, BZ,
+		CX, CY, CZ,
+		DX, DY, DZ,
+		LerpRatio,
+		// Converts the spline's derivative back to a velocity (m/s)
+		InvDerivativeScale,
+		LocationX, LocationY, LocationZ,
+		VelocityX, VelocityY, VelocityZ,
+		NumStreams
+	};
+
+	static const int32 LaneCount = 4;
+
+	// Empties the batch, keeping its allocations
+	void Reset();
+
+	void Add(UGoKartMovementReplicator* Replicator, const FHermiteCubicSpline& Spline, float InLerpRatio, float InInvDerivativeScale, const FQuat& StartRotation, const FQuat& TargetRotation);
+
+	int32 Num() const { return Replicators.Num(); };
+
+	// Fills in every kart's location, velocity and rotation
+	void Evaluate();
+
+	// Hands each kart its result
+	void Apply() const;
+
+private:
+	TArray<float> Streams[NumStreams];
+
+	TArray<UGoKartMovementReplicator*> Replicators;
+
+	TArray<FQuat> StartRotations;
+
+	TArray<FQuat> TargetRotations;
+
+	TArray<FQuat> Rotations;
+};
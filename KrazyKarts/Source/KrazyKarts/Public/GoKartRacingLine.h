@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GoKartRacingLine.generated.h"
+
+class USplineComponent;
+
+// The racing line at one distance along the track
+USTRUCT()
+struct FGoKartRacingLineSample
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	FVector Location;
+
+	// Signed, positive turning right (1/m)
+	UPROPERTY()
+	float Curvature;
+
+	// Fastest a kart can take this point and still make the corners after it (m/s)
+	UPROPERTY()
+	float TargetSpeed;
+};
+
+// Closed loop drawn with a spline in the editor. Editing it bakes samples at a fixed spacing, so bots look
+// the line up by distance at runtime and never touch the spline or the world.
+UCLASS()
+class KRAZYKARTS_API AGoKartRacingLine : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AGoKartRacingLine();
+
+	virtual void OnConstruction(const FTransform& Transform) override;
+
+	// Resamples the spline into Samples
+	void Bake();
+
+	bool IsBaked() const { return Samples.Num() > 0; };
+
+	// Length of the loop (cm)
+	float GetLength() const { return Samples.Num() * BakedSpacing; };
+
+	// Wraps Distance onto the loop
+	float WrapDistance(float Distance) const;
+
+	// Sample at or before Distance, wrapped onto the loop
+	const FGoKartRacingLineSample& GetSample(float Distance) const;
+
+	// Location interpolated between the samples either side of Distance
+	FVector GetLocation(float Distance) const;
+
+	// Distance of the sample nearest Location within SearchRange either side of Hint, or anywhere on the loop when
+	// Location is more than MaxLineDistance from every sample in range (cm)
+	float FindDistance(const FVector& Location, float Hint, float SearchRange) const;
+
+	// Location and facing of a starting slot, in rows of two behind distance 0
+	FTransform GetGridSlot(int32 Slot) const;
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	UPROPERTY(VisibleAnywhere, Category = "Racing Line")
+	USplineComponent* Spline;
+
+	// Distance between baked samples (cm)
+	UPROPERTY(EditAnywhere, Category = "Racing Line", meta = (ClampMin = "10"))
+	float SampleSpacing = 100.0f;
+
+	// Speed bots aim for on straights (m/s)
+	UPROPERTY(EditAnywhere, Category = "Racing Line", meta = (ClampMin = "1"))
+	float MaxSpeed = 25.0f;
+
+	// Sideways acceleration bots allow themselves in corners (m/s^2)
+	UPROPERTY(EditAnywhere, Category = "Racing Line", meta = (ClampMin = "0.1"))
+	float MaxLateralAcceleration = 10.0f;
+
+	// Deceleration bots plan to brake at ahead of corners (m/s^2)
+	UPROPERTY(EditAnywhere, Category = "Racing Line", meta = (ClampMin = "0.1"))
+	float MaxBrakingDeceleration = 8.0f;
+
+	// Beyond this from the line near where a bot was, it is searched for along the whole loop (cm)
+	UPROPERTY(EditAnywhere, Category = "Racing Line", meta = (ClampMin = "0"))
+	float MaxLineDistance = 1000.0f;
+
+	UPROPERTY()
+	TArray<FGoKartRacingLineSample> Samples;
+
+	// SampleSpacing stretched so the loop closes on a whole sample
+	UPROPERTY()
+	float BakedSpacing;
+
+	float InvBakedSpacing;
+};
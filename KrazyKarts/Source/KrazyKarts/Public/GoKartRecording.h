@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartMovementComp.h"
+
+// Records every client move the server simulates, and each kart's state when its first move arrives,
+// to a compact binary file. "kart.Replay.Play" re-simulates a recording through UGoKartMovementComp and
+// reports how far karts diverged from the recorded checkpoints and how long simulation took.
+//
+// File: header, then one chunk per server frame that had events. A chunk is its event count and bit
+// length as packed ints, followed by the events bit packed:
+//   Spawn       full precision dynamics params, location, rotation and velocity
+//   Move        sequence delta as a varint, inputs as one byte when exact, delta time as one bit when
+//               unchanged from the kart's previous move
+//   Checkpoint  quantized location, rotation and velocity after a move, for divergence checks
+struct KRAZYKARTS_API FGoKartRecorder
+{
+	static bool IsRecording() { return Writer != nullptr; };
+
+	static void StartRecording(const FString& Path);
+
+	static void StopRecording();
+
+	// Call before simulating a move received from MovementComp's owning client
+	static void RecordMove(const UGoKartMovementComp* MovementComp, const FGoKartMove& Move);
+
+	// Call after simulating received moves. Only written every kart.Replay.CheckpointInterval moves.
+	static void RecordState(const UGoKartMovementComp* MovementComp);
+
+	// Call when MovementComp's kart goes away. Its id is never reused.
+	static void RemoveKart(const UGoKartMovementComp* MovementComp);
+
+private:
+	struct FKart
+	{
+		uint32 Id;
+
+		uint32 LastSequence;
+
+		float LastDeltaTime;
+
+		int32 MovesSinceCheckpoint;
+	};
+
+	static FArchive* Writer;
+
+	static TMap<TWeakObjectPtr<const UGoKartMovementComp>, FKart> Karts;
+
+	static uint32 NextKartId;
+
+	static class FBitWriter* FrameWriter;
+
+	static uint32 FrameEvents;
+
+	static FDelegateHandle EndFrameHandle;
+
+	static void WriteFrame();
+};
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Uniform 2D grid over the track that tracks which karts each viewer should receive. Karts and viewers
+// only change cell once they are a margin past the border, and a viewer's relevant set is only rebuilt
+// when it changes cell or a kart enters or leaves a cell it can see.
+class KRAZYKARTS_API FGoKartRelevancyGrid
+{
+public:
+	// CellSize (cm), ViewRadius (cells around the viewer's cell), MaxFullRateKarts (nearest karts per viewer at full rate)
+	void Configure(float InCellSize, int32 InViewRadius, int32 InMaxFullRateKarts);
+
+	void RemoveKart(const AActor* Kart);
+
+	// Call for every kart, then every viewer, then EndUpdate, once per frame
+	void UpdateKart(const AActor* Kart, const FVector& Location);
+
+	// bRefreshFullRate re-picks the nearest karts even when the relevant set did not change
+	void UpdateViewer(const AActor* Viewer, const FVector& Location, bool bRefreshFullRate);
+
+	// Forgets viewers that were not updated this frame
+	void EndUpdate();
+
+	bool IsRelevant(const AActor* Kart, const AActor* Viewer) const;
+
+	bool IsFullRate(const AActor* Kart, const AActor* Viewer) const;
+
+	// Most karts relevant to any one viewer that Kart is relevant to. 0 when no viewer receives Kart.
+	int32 GetMaxRelevantCount(const AActor* Kart) const;
+
+	// True when a kart other than Kart was within Distance of Location at the last update. Only reads the
+	// cells around Location, and is safe to call from several threads while the grid is not updated.
+	bool IsOtherKartNear(const AActor* Kart, const FVector& Location, float Distance) const;
+
+	// Drops all karts and viewers, e.g. when the cell size changes
+	void Reset();
+
+private:
+	struct FKart
+	{
+		FIntPoint Cell;
+
+		FVector Location;
+	};
+
+	struct FViewer
+	{
+		FIntPoint Cell;
+
+		FVector Location;
+
+		TSet<const AActor*> Relevant;
+
+		TSet<const AActor*> FullRate;
+
+		uint32 LastUpdate;
+	};
+
+	float CellSize = 5000.0f;
+
+	// Distance past a cell's border before changing cell (cm)
+	float Hysteresis = 1000.0f;
+
+	int32 ViewRadius = 2;
+
+	int32 MaxFullRateKarts = 16;
+
+	uint32 UpdateCount = 0;
+
+	TMap<const AActor*, FKart> Karts;
+
+	TMap<FIntPoint, TArray<const AActor*>> Cells;
+
+	TMap<const AActor*, FViewer> Viewers;
+
+	// Cells a kart entered or left this frame
+	TSet<FIntPoint> DirtyCells;
+
+	FIntPoint GetCell(const FVector& Location) const;
+
+	FIntPoint GetCellWithHysteresis(const FVector& Location, const FIntPoint& CurrentCell) const;
+
+	bool IsNeighbourhoodDirty(const FIntPoint& Cell) const;
+
+	void RebuildRelevant(FViewer& Viewer);
+
+	void RebuildFullRate(FViewer& Viewer);
+};
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/ArrayView.h"
+#include "WorldCollision.h"
+#include "GoKartDynamics.h"
+#include "GoKartMovementComp.h"
+
+class FGoKartRelevancyGrid;
+class FGoKartTrackCollision;
+
+// One kart's client moves for a server frame, with everything needed to simulate them away from the actor
+struct FGoKartServerSimJob
+{
+	// Shared with every kart of the same tuning, see UGoKartMovementComp::GetDynamicsParams
+	const FGoKartDynamicsParams* Params;
+
+	// Collision of the kart's root component, captured on the game thread
+	FCollisionShape Shape;
+
+	ECollisionChannel Channel;
+
+	FCollisionQueryParams QueryParams;
+
+	FCollisionResponseParams ResponseParams;
+
+	// Half width for the track grid (cm)
+	float TrackCollisionRadius;
+
+	// How far in the past the owning client saw other karts. See UGoKartMovementComp::SetContactRewindTime.
+	float ContactRewindTime;
+
+	// Index of this kart in the kart locations passed to Simulate
+	int32 KartIndex;
+
+	// Only compared against, to skip the kart itself in the kart grid passed to Simulate
+	const AActor* Kart;
+
+	// In: state before the first move. Out: state after the last.
+	FVector Location;
+
+	FQuat Rotation;
+
+	FVector Velocity;
+
+	TArray<FGoKartMove> Moves;
+};
+
+// Simulates many karts' moves at once across worker threads. Workers only read the world, with the
+// transforms every kart had at the start of the frame, so the result does not depend on how jobs are
+// split between threads. Callers write the results back to the actors afterwards, in a fixed order.
+struct KRAZYKARTS_API FGoKartServerSimulation
+{
+	// KartLocations are every kart's location at the start of the frame, used to fall back from the track grid
+	// to a sweep near other karts. KartGrid, when set, holds the same locations bucketed by cell and is searched
+	// instead. Track and KartGrid may be null. MaxTasks of 1 runs on the calling thread.
+	static void Simulate(const UWorld* World, const FGoKartTrackCollision* Track, const FGoKartRelevancyGrid* KartGrid, const TArray<FVector>& KartLocations, TArrayView<FGoKartServerSimJob> Jobs, int32 MaxTasks);
+
+	// kart.Parallel.MaxTasks, or one task per worker thread plus the game thread
+	static int32 GetMaxTasks();
+
+private:
+	static void SimulateJob(const UWorld* World, const FGoKartTrackCollision* Track, const FGoKartRelevancyGrid* KartGrid, const TArray<FVector>& KartLocations, FGoKartServerSimJob& Job);
+};
@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Server state of a kart at a server timestamp
+struct FGoKartSnapshot
+{
+	float Time = 0.0f;
+
+	FVector Location = FVector::ZeroVector;
+
+	FQuat Rotation = FQuat::Identity;
+
+	// m/s
+	FVector Velocity = FVector::ZeroVector;
+};
+
+// Fixed capacity window of the newest snapshots, oldest first, sampled at an arbitrary time in between
+class KRAZYKARTS_API FGoKartSnapshotBuffer
+{
+public:
+	// Must be a power of two
+	static const int32 Capacity = 16;
+
+	// Snapshots older than the newest one are ignored. When full, the oldest is dropped.
+	void Add(const FGoKartSnapshot& Snapshot);
+
+	void Reset() { Head = 0; Count = 0; };
+
+	int32 Num() const { return Count; };
+
+	// Index 0 is the oldest snapshot
+	const FGoKartSnapshot& operator[](int32 Index) const
+	{
+		check(Index >= 0 && Index < Count);
+		return Snapshots[(Head + Index) & (Capacity - 1)];
+	};
+
+	const FGoKartSnapshot& Newest() const { return (*this)[Count - 1]; };
+
+	// Hermite interpolates between the snapshots either side of Time. Past the newest snapshot, dead reckons
+	// for at most MaxExtrapolationTime. Returns false when the buffer is empty.
+	bool Sample(float Time, float MaxExtrapolationTime, FGoKartSnapshot& OutSnapshot) const;
+
+	// Index of the snapshot starting the segment that Time falls inside, or INDEX_NONE when Time is not
+	// strictly between the oldest and newest snapshots
+	int32 FindSegment(float Time) const;
+
+private:
+	FGoKartSnapshot Snapshots[Capacity];
+
+	int32 Head = 0;
+
+	int32 Count = 0;
+};
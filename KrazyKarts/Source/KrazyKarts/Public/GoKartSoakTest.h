@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "GoKartMovementReplicator.h"
+#include "GoKartSoakTest.generated.h"
+
+class UNetConnection;
+
+// Network soak test across a server and its connected clients. Start it on the server with "kart.Soak.Start";
+// it replicates to every client, and each process then emulates the configured latency, jitter and loss
+// on its outgoing packets ("Net PktLag" and friends, so not in shipping builds). Clients drive their kart
+// with scripted input. Every process writes corrections, simulated proxy error and bytes/s per connection
+// to CSV once a second and, at the end, logs PASSED or FAILED against the kart.Soak.Max* thresholds.
+// Clients need no GPU, run them with -nullrhi. For CI, run the KrazyKarts.Net.Soak automation test on the
+// server and every client instead, which reports each failed threshold as a test error.
+UCLASS(NotPlaceable, Transient)
+class KRAZYKARTS_API AGoKartSoakTest : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AGoKartSoakTest();
+
+	// Broadcast on every process as its test finishes, with the thresholds it failed
+	DECLARE_MULTICAST_DELEGATE_TwoParams(FOnFinished, UWorld*, const TArray<FString>&);
+	static FOnFinished OnFinished;
+
+	// Server only. Spawns and starts a test from kart.Soak.Start's arguments, or logs why it can not.
+	static AGoKartSoakTest* Start(UWorld* World, const TArray<FString>& Args);
+
+	// Server only. Starts once MinClients connections are open. Lag and variance in ms, loss in percent.
+	void StartTest(float Duration, int32 MinClients, int32 PktLag, int32 PktLagVariance, int32 PktLoss, const FString& CsvPath);
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// Totals for one connection over the whole test
+	struct FConnectionTotals
+	{
+		double InBytes = 0;
+
+		double OutBytes = 0;
+
+		float Time = 0;
+	};
+
+	UPROPERTY(Replicated)
+	float TestDuration;
+
+	UPROPERTY(Replicated)
+	int32 PktLag;
+
+	UPROPERTY(Replicated)
+	int32 PktLagVariance;
+
+	UPROPERTY(Replicated)
+	int32 PktLoss;
+
+	UPROPERTY(ReplicatedUsing = OnRep_Running)
+	bool bRunning;
+
+	int32 MinClients;
+
+	bool bFinished;
+
+	float TestTime;
+
+	float TimeSinceRow;
+
+	FString CsvPath;
+
+	TArray<FString> CsvLines;
+
+	FGoKartNetErrorStats TotalErrorStats;
+
+	// By remote address
+	TMap<FString, FConnectionTotals> ConnectionTotals;
+
+	UFUNCTION()
+	void OnRep_Running();
+
+	void BeginTest();
+
+	void DriveLocalKart();
+
+	void GetConnections(TArray<UNetConnection*>& OutConnections) const;
+
+	void WriteRow();
+
+	// Logs the result against the thresholds, writes the CSV and broadcasts OnFinished
+	void FinishTest();
+};
@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartSnapshotBuffer.h"
+
+// Server side record of where a kart was over the last second or so, oldest first, so contacts can be
+// resolved against where another client saw the kart instead of where it is now
+class KRAZYKARTS_API FGoKartStateHistory
+{
+public:
+	// Must be a power of two
+	static const int32 Capacity = 64;
+
+	// A snapshot at the newest snapshot's time replaces it, older ones are ignored. When full, the oldest is dropped.
+	void Add(const FGoKartSnapshot& Snapshot);
+
+	void Reset() { Head = 0; Count = 0; };
+
+	int32 Num() const { return Count; };
+
+	// Index 0 is the oldest snapshot
+	const FGoKartSnapshot& operator[](int32 Index) const
+	{
+		check(Index >= 0 && Index < Count);
+		return Snapshots[(Head + Index) & (Capacity - 1)];
+	};
+
+	// Linearly interpolates the kart's state at Time, clamped to the oldest and newest snapshots. False when empty.
+	bool Rewind(float Time, FGoKartSnapshot& OutSnapshot) const;
+
+private:
+	FGoKartSnapshot Snapshots[Capacity];
+
+	int32 Head = 0;
+
+	int32 Count = 0;
+};
+
+// Kart-on-kart contacts on the server, rewound to the instigating client's view of the other kart
+struct KRAZYKARTS_API FGoKartLagCompensation
+{
+	// kart.LagComp.KartContacts
+	static bool IsEnabled();
+
+	// True when a kart Radius wide moving from Start by Translation would also have reached Other where Other was
+	// at RewoundTime. Also true when Other is not a kart with a state history, so the contact stands as it is.
+	// Only reads Other, so it is safe from worker threads while no kart is written to.
+	static bool WouldHitRewound(const AActor* Other, float RewoundTime, const FVector& Start, const FVector& Translation, float Radius);
+};
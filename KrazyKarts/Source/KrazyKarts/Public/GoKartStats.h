@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("GoKart"), STATGROUP_GoKart, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SimulateMove"), STAT_GoKart_SimulateMove, STATGROUP_GoKart, KRAZYKARTS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("AutonomousProxy OnRep"), STAT_GoKart_AutonomousProxyOnRep, STATGROUP_GoKart, KRAZYKARTS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ClearAcknowledgedMoves"), STAT_GoKart_ClearAcknowledgedMoves, STATGROUP_GoKart, KRAZYKARTS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ClientTick"), STAT_GoKart_ClientTick, STATGROUP_GoKart, KRAZYKARTS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Server Receive Moves"), STAT_GoKart_ServerReceiveMoves, STATGROUP_GoKart, KRAZYKARTS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Server Drain Moves"), STAT_GoKart_ServerDrainMoves, STATGROUP_GoKart, KRAZYKARTS_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Moves Simulated"), STAT_GoKart_MovesSimulated, STATGROUP_GoKart, KRAZYKARTS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Moves Replayed"), STAT_GoKart_MovesReplayed, STATGROUP_GoKart, KRAZYKARTS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sweeps"), STAT_GoKart_Sweeps, STATGROUP_GoKart, KRAZYKARTS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Corrections"), STAT_GoKart_Corrections, STATGROUP_GoKart, KRAZYKARTS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Unacknowledged Moves"), STAT_GoKart_UnacknowledgedMoves, STATGROUP_GoKart, KRAZYKARTS_API);
+
+// Mirrors the stats above without the stats system, so per-frame values can be captured to CSV on
+// shipping and headless servers. Toggle with kart.Stats.StartCsv and kart.Stats.StopCsv.
+struct KRAZYKARTS_API FGoKartStats
+{
+	enum ECounter
+	{
+		MovesSimulated,
+		MovesReplayed,
+		Sweeps,
+		Corrections,
+		UnacknowledgedMoves,
+		NumCounters
+	};
+
+	enum ETimer
+	{
+		SimulateMove,
+		AutonomousProxyOnRep,
+		ClearAcknowledgedMoves,
+		ClientTick,
+		ServerReceiveMoves,
+		ServerDrainMoves,
+		NumTimers
+	};
+
+	static bool IsCapturing() { return bCapturing; };
+
+	// Safe to call from any thread
+	static void Increment(ECounter Counter, int32 Amount = 1)
+	{
+		if (bCapturing) FPlatformAtomics::InterlockedAdd(&Counters[Counter], Amount);
+	};
+
+	static void AddCycles(ETimer Timer, uint32 Cycles)
+	{
+		FPlatformAtomics::InterlockedAdd(&TimerCycles[Timer], (int32)Cycles);
+	};
+
+	static void StartCsv(const FString& Path);
+
+	static void StopCsv();
+
+private:
+	static bool bCapturing;
+
+	static volatile int32 Counters[NumCounters];
+
+	static volatile int32 TimerCycles[NumTimers];
+
+	static void WriteFrame();
+};
+
+// Times a scope into FGoKartStats while a capture is running
+struct FGoKartScopeTimer
+{
+	explicit FGoKartScopeTimer(FGoKartStats::ETimer InTimer)
+		: Timer(InTimer)
+		, StartCycles(FGoKartStats::IsCapturing() ? FPlatformTime::Cycles() : 0)
+	{
+	};
+
+	~FGoKartScopeTimer()
+	{
+		if (StartCycles != 0) FGoKartStats::AddCycles(Timer, FPlatformTime::Cycles() - StartCycles);
+	};
+
+private:
+	FGoKartStats::ETimer Timer;
+
+	uint32 StartCycles;
+};
+
+#define GOKART_SCOPE_CYCLE_COUNTER(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_GoKart_##Name); \
+	FGoKartScopeTimer ANONYMOUS_VARIABLE(GoKartScopeTimer)(FGoKartStats::Name)
+
+// Expands to a single statement so it can follow a braceless if
+#define GOKART_INC_COUNTER(Name, Amount) \
+	do \
+	{ \
+		INC_DWORD_STAT_BY(STAT_GoKart_##Name, Amount); \
+		FGoKartStats::Increment(FGoKartStats::Name, Amount); \
+	} while (0)
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// The track's static collision baked into a 2D height grid, so kart moves can be resolved with a few array
+// reads instead of a physics sweep. Each cell stores the highest static surface under it. A cell more than
+// MaxStepHeight above the floor a move starts on is a wall. Cells covered by anything movable are flagged,
+// and moves touching them report Unknown so the caller falls back to a sweep. Single layer tracks only:
+// anything overhead, like a bridge, reads as a wall.
+class KRAZYKARTS_API FGoKartTrackCollision
+{
+public:
+	enum class EMoveResult : uint8
+	{
+		Clear,
+		Blocked,
+		// Outside the grid or near something dynamic, use a physics sweep
+		Unknown
+	};
+
+	// Traces the static world inside Bounds down onto a grid of CellSize (cm). Ignores IgnoredActors, e.g. karts.
+	bool Bake(UWorld* World, const FBox& Bounds, float InCellSize, float InMaxStepHeight, const TArray<AActor*>& IgnoredActors);
+
+	void Reset();
+
+	bool IsBaked() const { return Heights.Num() > 0; };
+
+	// Moves a kart of half width Radius from Start by Translation. OutTime is the fraction of Translation
+	// that can be travelled before touching a wall, 1 when Clear.
+	EMoveResult Move(const FVector& Start, const FVector& Translation, float Radius, float& OutTime) const;
+
+	int32 GetAllocatedSize() const { return Heights.GetAllocatedSize() + Flags.GetAllocatedSize(); };
+
+private:
+	enum ECellFlags
+	{
+		// Nothing under the cell, drives like open floor
+		Empty = 1 << 0,
+		// Under something movable
+		Dynamic = 1 << 1
+	};
+
+	FVector2D Origin;
+
+	float CellSize;
+
+	float InvCellSize;
+
+	float BaseZ;
+
+	int32 SizeX;
+
+	int32 SizeY;
+
+	// Stored in cell height units (cm above BaseZ)
+	int32 MaxStepHeight;
+
+	TArray<int16> Heights;
+
+	TArray<uint8> Flags;
+
+	int32 GetCellIndex(int32 X, int32 Y) const { return Y * SizeX + X; };
+
+	FIntPoint GetCell(const FVector2D& Location) const;
+
+	// Height of the floor a kart at Location stands on, false when there is no reliable answer
+	bool GetFloorHeight(const FVector2D& Location, int32& OutHeight) const;
+};
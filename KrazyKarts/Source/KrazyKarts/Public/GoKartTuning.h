@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "GoKartDynamics.h"
+#include "GoKartTuning.generated.h"
+
+// Handling shared by every kart that references it. Read only at runtime, so a server keeps one copy per
+// kind of kart instead of one per kart. Karts without one use this class's defaults.
+UCLASS(BlueprintType)
+class KRAZYKARTS_API UGoKartTuning : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	virtual void PostInitProperties() override;
+
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	// Params with derived constants, at the project's default gravity
+	const FGoKartDynamicsParams& GetParams() const { return Params; };
+
+private:
+	// The Mass of the car (kg). 1000kg = 1ton
+	UPROPERTY(EditAnywhere, Category = "Dynamics", meta = (ClampMin = "1"))
+	float Mass = 1000.0f;
+
+	// The force applied to the car when the throttle is fully down (N)
+	UPROPERTY(EditAnywhere, Category = "Dynamics")
+	float MaxDrivingForce = 10000.0f;
+
+	// Minimum radius of the car turning circle at full lock (m)
+	UPROPERTY(EditAnywhere, Category = "Dynamics", meta = (ClampMin = "0.1"))
+	float MinTurningRadius = 10.0f;
+
+	// Higher means more drag. 
+	UPROPERTY(EditAnywhere, Category = "Dynamics")
+	float DragCoef = 16.0f;
+
+	// Higher means more Rolling Resistance.
+	UPROPERTY(EditAnywhere, Category = "Dynamics")
+	float RollingResistanceCoef = 0.015;
+
+	FGoKartDynamicsParams Params;
+
+	void UpdateParams();
+};